@@ -11,6 +11,7 @@
 //#include "PVTable.h"
 
 class HashTable;
+struct TTStats;
 #include "HashTable.h"
 #include <string>
 
@@ -81,12 +82,9 @@ class Board{
 		U64 zHist[MAX_MOVES];
 		//PVTable *pvTable;
 		HashTable *hashTable;
+		//counters of the thread searching this board, null outside a search
+		TTStats *ttStats;
 
-		int pvArray[MAX_DEPTH];
-		
-		int searchHistory[14][64];
-		int searchKillers[2][MAX_DEPTH];
-		
 		static std::string RANKS[8];
 		static std::string FILES[8];
 		static std::string START_POS;
@@ -94,8 +92,9 @@ class Board{
 		//void setPVTable(PVTable *tb);
 		void setHashTable(HashTable *tb);
 		void resetSearchHeuristics();
-		BoardState makeMove(int move);
-		BoardState makeNullMove();
+		//prefetchTT: the child will probe the hash table, start loading its bucket
+		BoardState makeMove(int move, bool prefetchTT = false);
+		BoardState makeNullMove(bool prefetchTT = false);
 		void undoMove(int move, BoardState undo);
 		void undoNullMove(BoardState undo);
 		bool isRepetition();
@@ -3,20 +3,84 @@
 
 #include "Board.h"
 #include "defs.h"
-#include "Engine/Search.h"
+#include <atomic>
+#include <mutex>
+#include <string>
 #define ISMATE (Search::INFINITE - Board::MAX_DEPTH)
 
 enum {HFNONE, HFALPHA, HFBETA, HFEXACT};
 
+// Packed entry, one atomic 64-bit word so concurrent readers never see a torn
+// entry:
+//   bits  0-15 compact move      bits 32-39 depth
+//   bits 16-31 score             bits 40-41 bound, 42-47 generation
+//   bits 48-63 upper 16 bits of the zobrist key (the low bits pick the bucket)
+// The static eval of the position is kept next to it in the bucket.
 class HashEntry{
 	public:
-		U64 zKey;
-		int move;
-		int score;
-		int depth;
-		int flags;
+		std::atomic<U64> data;
 
-		HashEntry():zKey((U64)0), move(0), score(0), depth(0), flags(0){}
+		HashEntry():data((U64)0){}
+
+		static const int GENERATION_MASK = 0x3F;
+		//bump when the packed layout changes, snapshots record it
+		static const int FORMAT = 2;
+		//no static eval stored, in check or not computed
+		static const int NO_EVAL = -32768;
+
+		//a writer is changing the slot, stored entries always have a bound so never equal it
+		static const U64 BUSY = 1;
+
+		static U64 pack(U64 zKey, int move16, int score, int depth, int flags, int generation);
+		static bool matches(U64 data, U64 zKey){ return (data >> 48) == (zKey >> 48) && data != 0 && data != BUSY;}
+		static int move(U64 data){ return (int)(data & 0xFFFF);}
+		static int score(U64 data){ return (int16_t)((data >> 16) & 0xFFFF);}
+		static int depth(U64 data){ return (int8_t)((data >> 32) & 0xFF);}
+		static int flags(U64 data){ return (int)((data >> 40) & 0x3);}
+		static int generation(U64 data){ return (int)((data >> 42) & GENERATION_MASK);}
+		static int age(U64 data, int generation){ return (generation - HashEntry::generation(data)) & GENERATION_MASK;}
+};
+
+// Hash table counters. Each search thread counts into its own copy so the
+// search never writes to a shared line; the copies are added into the table's
+// totals once the threads are joined.
+struct TTStats{
+	//per-depth counters, deeper drafts go to the last slot
+	static const int DEPTHS = 32;
+
+	U64 probes;
+	U64 hits;
+	//probes that returned a score usable as a cutoff
+	U64 cutoffs;
+	U64 stores;
+	U64 newWrites;
+	U64 sameWrites;
+	//a live entry of another position was evicted
+	U64 overWrites;
+	//another thread was writing the slot
+	U64 dropped;
+	U64 depthProbes[DEPTHS];
+	U64 depthHits[DEPTHS];
+	//filled in by the search when merging
+	U64 searches;
+	U64 nodes;
+	//quiescence nodes, counted by the search threads
+	U64 qnodes;
+
+	TTStats(){ reset(); }
+	void reset();
+	void add(const TTStats& other);
+	static int slot(int depth){ return depth < 0 ? 0 : (depth >= DEPTHS ? DEPTHS - 1 : depth);}
+};
+
+// One cache line of entries, probed together, followed by their static evals.
+// A writer holds the entry as BUSY while it changes the eval, so a reader
+// takes the eval only if the entry reads the same before and after it.
+class alignas(64) HashBucket{
+	public:
+		static const int SIZE = 6;
+		HashEntry entries[SIZE];
+		std::atomic<int16_t> evals[SIZE];
 };
 
 class HashTable{
@@ -24,24 +88,76 @@ class HashTable{
 		//max size in MB
 		HashTable();
 		HashTable(int sizeMB);
+		~HashTable();
+		//(re)allocates the table, freeing any previous one
 		void initHash(int size);
-		static bool probeHashEntry(Board& board, int *move, int *score, int alpha, int beta, int depth);
+		//true on a cutoff, entryDepth/entryFlags describe any entry found
+		static bool probeHashEntry(Board& board, int *move, int *score, int alpha, int beta, int depth,
+			int *entryDepth = nullptr, int *entryFlags = nullptr, int *entryEval = nullptr);
 		static int probePvMove(Board& board);
-		static void storeHashEntry(Board& board, const int move, int score, const int flags, const int depth);
-		static int getPVLine(int depth, Board& board);
-		static bool moveExists(Board& board, int move, int side);
+		static void storeHashEntry(Board& board, const int move, int score, const int flags, const int depth,
+			int eval = HashEntry::NO_EVAL);
+		//O(1): entries written before the reset become stale
 		void reset();
+		//true wipe of the whole table
+		void clear();
+		//snapshots on disk, the table size must match on load
+		bool save(std::string file);
+		bool load(std::string file);
 
-		HashEntry *table;
-		static BoardState undoList[];
-		//rounded down to power of 2
-		U32 numEntries;
-		U32 numEntries_1;
-		int newWrite;
-		int overWrite;
-		int hit;
-		int cut;
+		//permille of sampled entries written by the current search
+		int hashfull();
+		void printStats();
+
+		enum {STORE_NEW, STORE_SAME, STORE_OVERWRITE, STORE_DROPPED};
+		//raw access by key with compact moves, ply independent, returns one of the STORE_ values
+		int store(U64 zKey, int move16, int score, int flags, int depth, int eval = HashEntry::NO_EVAL);
+		bool probe(U64 zKey, int *move16, int *score, int *flags, int *depth, int *eval = nullptr);
+		static void stressTest(int numThreads, int seconds);
+		//age older entries, call once per search
+		void newSearch();
+		//start loading the bucket of zKey into cache ahead of the probe
+		void prefetch(U64 zKey){
+#if defined(_MSC_VER)
+			_mm_prefetch((const char*)&table[zKey & numBuckets_1], _MM_HINT_T0);
+#else
+			__builtin_prefetch(&table[zKey & numBuckets_1]);
+#endif
+		}
+
+		HashBucket *table;
+		//rounded down to power of 2, 64 bits as the largest Hash is 2^32 buckets
+		U64 numBuckets;
+		U64 numBuckets_1;
+		U64 numEntries;
+		//bytes actually mapped, and whether they came from explicit huge pages
+		U64 allocBytes;
+		bool hugeTLB;
+		//atomic as searches of different contexts may share the table
+		//counts every bump, entries keep its low bits
+		std::atomic<int> generation;
+		//searches since the last reset, entries older than this are stale
+		std::atomic<int> liveAge;
+		//no entry in the table is older than oldestGeneration, the last reset
+		//was at resetGeneration
+		std::atomic<int> oldestGeneration;
+		std::atomic<int> resetGeneration;
+		//totals of the searches since the last reset, merged under statsLock
+		TTStats stats;
+		std::mutex statsLock;
 		const int DEFAULT_SIZE = 256;
+		static const U64 HUGE_PAGE_SIZE = 2 * 0x100000;
+
+	private:
+		void allocate(U64 bytes);
+		void freeTable();
+		void clearParallel();
+		//a search or a reset, reset makes every entry stale
+		void bumpGeneration(bool reset);
+		//empties the entries older than maxAge searches
+		void sweep(int maxAge);
+		void resetGenerations();
+		std::string pageInfo();
 };
 
 
@@ -5,12 +5,15 @@
 #include <algorithm>
 #include "defs.h"
 
+class Board;
+
 class MoveScore{
 	public:
 		int score;
 		int move;
 		
-		MoveScore() { move = 0; score = 0; };
+		//left uninitialized, move lists fill their entries as they go
+		MoveScore() = default;
 		MoveScore(int mv, int sc){
 			move = mv;
 			score = sc;
@@ -38,23 +41,41 @@ class Move{
 		static bool isPJ(int move);
 		static bool isCastle(int move);
 		static int promoteTo(int move);
+		//16 bit form for the hash table: from, to, promotion piece, special kind
+		static int toCompact(int move);
+		static int fromCompact(const Board& board, int move16);
 		static std::string toNotation(int move);
 		static std::string toLongNotation(int move);		
 		static void print(int move);
 };
 
+// Fixed capacity list of moves with an ordering score next to each, lives on
+// the stack so generating and ordering moves never touches the heap
 class MoveList{
 	private:
-		int moves[Move::MAX_LEGAL_MOVES];		
+		MoveScore moves[Move::MAX_LEGAL_MOVES];
 		int n = 0;
 		
 	public:
 		void reset(){ n = 0;}
-		void add(int move){moves[n++] = move;}
-		int get(int i){ return moves[i];}
-		void set(int idx, int mv){moves[idx] = mv;}
+		void add(int move){moves[n++].move = move;}
+		int get(int i){ return moves[i].move;}
+		void set(int idx, int mv){moves[idx].move = mv;}
 		int size(){return n;}
-		int last(){return moves[n - 1];}
+		int last(){return moves[n - 1].move;}
+		int score(int i){ return moves[i].score;}
+		void setScore(int i, int sc){ moves[i].score = sc;}
+
+		//selection step: swaps the best scored move of [from, size) into from
+		int pickBest(int from){
+			int best = from;
+			for (int i = from + 1; i < n; i++){
+				if (moves[i].score > moves[best].score)
+					best = i;
+			}
+			std::swap(moves[from], moves[best]);
+			return moves[from].move;
+		}
 };
 
 #endif
\ No newline at end of file
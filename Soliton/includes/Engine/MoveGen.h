@@ -18,6 +18,8 @@ class MoveGen{
 		static void pseudoLegalMoves(Board* board, int side, MoveList& moves, bool atCheck);
 		static bool isLegalMove(Board* board, int move, int side, bool atCheck, U64 pinned);
 		static void pseudoLegalCaptureMoves(Board* board, int side, MoveList& capts);
+		static void pseudoLegalQuietMoves(Board* board, int side, MoveList& moves);
+		static bool isPseudoLegal(Board* board, int move, int side, bool atCheck);
 
 		static bool can_castle_ks(Board* board, int side, U64 occup);
 		static bool can_castle_qs(Board* board, int side, U64 occup);
@@ -0,0 +1,87 @@
+#ifndef MOVE_PICKER_H
+#define MOVE_PICKER_H
+
+#include "Board.h"
+#include "Move.h"
+#include <cstdint>
+
+// [piece][to] scores of quiet moves
+typedef int16_t PieceToHistory[14][64];
+
+// Move ordering statistics of one search thread. Every update pulls the entry
+// towards +-MAX_HISTORY in proportion to the distance left, so the scores stay
+// bounded and old results fade as new ones come in.
+struct HistoryTables {
+	static constexpr int MAX_HISTORY = 16384;
+
+	PieceToHistory quiet;
+	//[piece][to][captured piece]
+	int16_t capture[14][64][14];
+	//quiet move that refuted the previous move, by its [piece][to]
+	int counterMoves[14][64];
+	//[previous piece][previous to] of the move one or two plies up, then [piece][to]
+	PieceToHistory continuation[14][64];
+
+	void clear();
+	static void update(int16_t& entry, int bonus);
+	//bonus of a cutoff at depth, the moves that failed to cut get its negative
+	static int bonus(int depth);
+	//moving piece and destination square, castling counts as the king move
+	static int piece(const Board& board, int move);
+	static int to(const Board& board, int move);
+	//captured piece, en passant included
+	static int victim(const Board& board, int move);
+};
+
+// Hands out the pseudo legal moves of a node one at a time, best first. Each
+// group is generated only when the previous one runs out: hash move, captures
+// that do not lose material, killers, the counter move, quiets by history, then
+// losing captures.
+// In check all evasions are scored together. The captures only mode, for
+// quiescence, stops after the good captures.
+class MovePicker{
+	public:
+		//cont holds the continuation rows of the moves one and two plies up
+		MovePicker(Board& board, const HistoryTables& history, const PieceToHistory* const cont[2], const int killers[2],
+			int counterMove, int ttMove, bool inCheck);
+		//quiescence, captures only unless in check
+		MovePicker(Board& board, const HistoryTables& history, const int killers[2], int ttMove, bool inCheck);
+		//Move::NO_MOVE once every move has been returned
+		int next();
+		static void init();
+		//no capture, en passant or promotion, what the quiet stage generates
+		static bool isQuiet(int move);
+
+	private:
+		enum {
+			TT_MOVE, INIT_CAPTURES, GOOD_CAPTURES, KILLER_1, KILLER_2, COUNTER_MOVE, INIT_QUIETS, QUIETS, BAD_CAPTURES,
+			EVASION_TT_MOVE, INIT_EVASIONS, EVASIONS, DONE
+		};
+
+		Board& board;
+		const HistoryTables& history;
+		const PieceToHistory* cont[2];
+		int side;
+		int stage;
+		bool inCheck;
+		bool capturesOnly;
+		int ttMove;
+		int killers[2];
+		int counterMove;
+
+		MoveList moves;
+		int current;
+		MoveList badCaptures;
+		int currentBad;
+
+		void scoreCaptures();
+		void scoreQuiets();
+		void scoreEvasions();
+		bool isKiller(int move);
+		int quietScore(int move);
+		int captureScore(int move);
+		//MVV-LVA [victim][attacker]
+		static int MVV_LVA[14][14];
+};
+
+#endif
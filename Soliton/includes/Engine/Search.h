@@ -3,41 +3,191 @@
 
 #include "Board.h"
 #include "Move.h"
+#include "HashTable.h"
+#include "MovePicker.h"
 #include <chrono>
 #include <atomic>
 
+// Per-ply state of one search thread, indexed by board.ply
+struct SearchStack {
+    int staticEval;
+    // Set while verifying that the hash move is singular: the node is searched
+    // without it, and neither cuts on nor stores to the hash table
+    int excludedMove = Move::NO_MOVE;
+    // Move made from this ply, NO_MOVE for a null move, with its piece and
+    // destination for the counter move and continuation history of the plies below
+    int move = Move::NO_MOVE;
+    int piece = Board::EMPTY;
+    int to = 0;
+    // Quiet moves that caused a cutoff at this ply, most recent first
+    int killers[2] = { Move::NO_MOVE, Move::NO_MOVE };
+};
+
+class SearchContext;
+struct SearchThread;
+
+// One line of a MultiPV search: a root move, its score and its PV
+struct RootLine {
+    int move = Move::NO_MOVE;
+    int score = 0;
+    int pv[Board::MAX_DEPTH];
+    int pvLength = 0;
+};
+
 class Search {
 public:
-    static const int INFINITE = 30000;
-    static const int MATE = 29000;
-    static const int INVALID_SCORE = -999999;
-
-    struct SearchParams {
-        long nodes;
-        int bestMove;
-        int depthLimit;
-        long long timeLimit; // in milliseconds
-        long long startTime;
-        std::atomic<bool> stopped;
+    static constexpr int INFINITE = 30000;
+    static constexpr int MATE = 29000;
+    static constexpr int INVALID_SCORE = -999999;
+    static constexpr int MAX_THREADS = 256;
+    static constexpr int MAX_MULTI_PV = 64;
+    // Half width of the first aspiration window and the depth it starts at
+    static constexpr int ASPIRATION_WINDOW = 50;
+    static constexpr int ASPIRATION_DEPTH = 4;
+
+    // Internal iteration modes. Reduce searches the node a ply shallower (IIR),
+    // the hash move of this iteration will order the next one. Search first
+    // runs a reduced search of the node itself to find a move to try first (IID).
+    enum { IID_OFF, IID_REDUCE, IID_SEARCH };
+    static constexpr int IID_DEPTH = 4;
+
+    // Search parameters exposed as UCI options for tuning
+    struct Tunables {
+        // LMR: reduction = base + log(depth) * log(moveNumber) / divisor, both x100
+        int lmrBase = 75;
+        int lmrDivisor = 225;
+        // Frontier pruning margins in centipawns per ply of depth
+        int rfpMargin = 75;
+        int futilityMargin = 100;
+        int razorMargin = 250;
+        // Null move: one more ply of reduction per this much eval above beta, up to 3
+        int nullMoveDivisor = 200;
+        // ProbCut: how far above beta a capture must score in the reduced search
+        int probCutMargin = 200;
+        // Nodes without a hash move: IID_OFF, IID_REDUCE or IID_SEARCH
+        int iidMode = IID_REDUCE;
     };
+    static constexpr int LMR_DEPTH = 3;
+    static constexpr int LMR_MOVES = 64;
+    // One ply less reduction per this much combined history, one more below its negative
+    static constexpr int LMR_HISTORY = 6144;
+    static constexpr int RFP_DEPTH = 3;
+    static constexpr int FUTILITY_DEPTH = 3;
+    static constexpr int RAZOR_DEPTH = 2;
+    // Null move: minimum depth, base reduction (plus a ply per 4 of depth), and
+    // the depth from which a fail high is verified
+    static constexpr int NULL_MOVE_DEPTH = 3;
+    static constexpr int NULL_MOVE_R = 3;
+    static constexpr int NULL_VERIFY_DEPTH = 12;
+    // ProbCut: minimum depth, and how much shallower the captures are searched
+    static constexpr int PROBCUT_DEPTH = 5;
+    static constexpr int PROBCUT_REDUCTION = 4;
+    // Singular extension: minimum depth, and the margin below the hash score per ply of depth
+    static constexpr int SINGULAR_DEPTH = 8;
+    static constexpr int SINGULAR_MARGIN = 2;
 
-    // Updated entry point
-    static int iterativeDeepening(Board& board, int maxDepth, long long moveTime, bool verbose);
+    // Searches board within the limits given, with the threads and stop flag of
+    // ctx, and leaves the result in ctx. Calls on different contexts can run
+    // concurrently.
+    static int iterativeDeepening(SearchContext& ctx, Board& board, int maxDepth, long long moveTime, bool verbose);
     //For eval FEN tool
-    static int iterativeDeepeningScore(Board& board, int maxDepth, long long moveTime, bool verbose);
-    static void stop();
-
-private:
-    static int alphaBeta(Board& board, int alpha, int beta, int depth, bool doNull);
-    static int quiescence(Board& board, int alpha, int beta);
+    static int iterativeDeepeningScore(SearchContext& ctx, Board& board, int maxDepth, long long moveTime, bool verbose);
+    // Static exchange evaluation of a capture on toSq, from the side to move
     static int see(const Board* board, int toSq, int target, int fromSq, int aPiece);
     static bool isBadCapture(const Board& board, int move, int side);
-    static void checkTime(); // Checks if we should stop the search
+    // Rebuilds the reduction table from tune, call after changing it and
+    // never while a search runs
+    static void initReductions();
+
+    // Shared by every context, read only while searching
+    static Tunables tune;
+
+private:
+    static void startThreads(SearchContext& ctx, Board& board, int maxDepth, long long moveTime, bool verbose, int numThreads);
+    static void searchWorker(SearchThread* t, bool verbose);
+    // Info line of one MultiPV line, the PV is printed with exact scores only
+    static void printInfo(SearchThread* t, int depth, int line, int score, int bound);
+    static int countLegalMoves(Board& board);
+    static bool isSearchedRootMove(const SearchThread& t, int move);
+    static SearchThread* voteBestThread(SearchContext& ctx);
+
+    static int alphaBeta(SearchThread& t, int alpha, int beta, int depth, bool doNull);
+    static int quiescence(SearchThread& t, int alpha, int beta);
+    static void checkTime(SearchContext& ctx); // Checks if we should stop the search
+
+    static int reduction(bool pvNode, int depth, int moveNumber);
+    static void updateHistories(SearchThread& t, PieceToHistory* const cont[2], int bestMove, int depth,
+                                const int* quiets, int quietCount, const int* captures, int captureCount);
+
+    static int reductions[Board::MAX_DEPTH][LMR_MOVES];
+};
+
+// Per-thread search state for Lazy SMP. Every thread searches the same root
+// on its own board copy with its own stack and history tables, sharing only
+// the hash table and its search context.
+struct SearchThread {
+    int id;
+    SearchContext* ctx;
+    Board board;
+    std::atomic<long long> nodes;
+    int rootBestMove;   // best root move found so far in the current iteration
+    int bestMove;       // best move of the last completed iteration
+    int bestScore;
+    int completedDepth;
+    int rootDepth;      // depth of the current iteration
+    TTStats ttStats;
+    SearchStack stack[Board::MAX_DEPTH];
+    // Triangular PV table: pv[ply] is the best line found from ply on, up to pvLength[ply]
+    int pv[Board::MAX_DEPTH][Board::MAX_DEPTH];
+    int pvLength[Board::MAX_DEPTH];
+    // PV of the last completed iteration
+    int bestPv[Board::MAX_DEPTH];
+    int bestPvLength;
+    // MultiPV: number of lines searched, at most the number of legal root moves,
+    // and the line being searched. Lines before pvIdx hold this iteration's
+    // results and their moves are skipped at the root, the others still hold
+    // the previous iteration's, best first.
+    int pvCount;
+    int pvIdx;
+    RootLine lines[Search::MAX_MULTI_PV];
+    HistoryTables history;
+
+    SearchThread() : id(0), ctx(nullptr), nodes(0), rootBestMove(0), bestMove(0), bestScore(0), completedDepth(0),
+        rootDepth(0), bestPvLength(0), pvCount(1), pvIdx(0) {}
+};
+
+// State of one search: its limits, stop flag and threads, and once it is done
+// its result. Independent searches each use their own context and can run
+// concurrently; a context runs one search at a time.
+class SearchContext {
+public:
+    int depthLimit;
+    long long timeLimit; // in milliseconds, -1 for none
+    long long startTime;
+    int numThreads;
+    int multiPV;
+    std::atomic<bool> stopped;
+    // only allocated while searching
+    SearchThread* threads;
+
+    // Result of the last search, from the thread that won the vote, or the
+    // main thread's first line with MultiPV
+    int bestMove;
+    int bestScore;
+    int completedDepth;
+    int pv[Board::MAX_DEPTH];
+    int pvLength;
 
-    static int scoreMove(const Board& board, int move, int pvMove);
-    static void sortMoves(MoveList& moves, const Board& board, int pvMove, int ply);
+    SearchContext() : depthLimit(Board::MAX_DEPTH), timeLimit(-1), startTime(0), numThreads(1), multiPV(1), stopped(false),
+        threads(nullptr), bestMove(Move::NO_MOVE), bestScore(0), completedDepth(0), pvLength(0) {}
 
-    static SearchParams params;
+    // Safe from any thread while the search runs
+    void stop();
+    //must be called before starting a search
+    void clearStop();
+    void setThreads(int n);
+    void setMultiPV(int n);
+    long long totalNodes() const;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -2,10 +2,14 @@
 #define TESTS_H
 
 #include <string>
+#include "Search.h"
 
 class TestSuite {
 public:
-	static void runFile(std::string file, int movetime);
+	//searches with the threads of ctx
+	static void runFile(SearchContext& ctx, std::string file, int movetime);
+	//fixed depth search of every step-th position, totals the nodes
+	static void runNodes(SearchContext& ctx, std::string file, int depth, int step);
 };
 
 #endif
\ No newline at end of file
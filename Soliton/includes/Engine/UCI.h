@@ -4,16 +4,40 @@
 #include <string>
 #include <vector>
 #include <thread>
+#include <functional>
 #include "Board.h"
 #include "HashTable.h"
+#include "Search.h"
+
+// An engine option as advertised to the GUI. Spin options hold an integer in
+// [min, max], check options hold 0 or 1. onChange applies a new value, the
+// default must match the engine state at startup.
+struct UCIOption {
+    std::string name;
+    std::string type;
+    int defaultValue;
+    int min;
+    int max;
+    int value;
+    std::function<void(int)> onChange;
+};
 
 class UCI {
 public:
     static void loop();
+    static void addOption(std::string name, std::string type, int defaultValue, int min, int max, std::function<void(int)> onChange);
+    static UCIOption* getOption(std::string name);
 private:
+    static void initOptions(HashTable* tt);
+    static void printOptions();
+    static void stopSearch();
+    static void parseSetOption(std::string line);
     static void parsePosition(std::string line, Board& board, HashTable* tt);
     static void parseGo(std::string line, Board& board);
     static std::thread searchThread;
+    static std::vector<UCIOption> options;
+    // the GUI's search, also used by bench
+    static SearchContext searchContext;
 };
 
-#endif
\ No newline at end of file
+#endif
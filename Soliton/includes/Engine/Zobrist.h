@@ -16,12 +16,14 @@ class Zobrist{
 		static U64 xorCastle(U64 key, int castle);
 		static U64 xorSide(U64 key);
 		static void init_keys();
+		//fingerprint of the key set, saved with hash table snapshots
+		static U64 checksum();
 		
 	private:
 		static U64 random64();
-		static std::random_device rd;
+		//fixed seed: keys are identical across runs and platforms
+		static const U64 SEED = 0x50C1170ULL;
 		static std::mt19937_64 gen;
-		static std::uniform_int_distribution<U64> dis;
 		static U64 pieceKeys[64][12];
 		static U64 castleKeys[16];
 		static U64 epKeys[8];
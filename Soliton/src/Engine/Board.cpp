@@ -29,6 +29,7 @@ static const int CASTLE_PERM[64] = {
 
 Board::Board(){
 	hashTable = NULL;
+	ttStats = NULL;
 	material[0] = 0;
 	material[1] = 0;
 
@@ -59,25 +60,12 @@ void Board::setHashTable(HashTable *tb){
 }
 
 void Board::resetSearchHeuristics() {
-	// Clear History Table
-	for (int i = 0; i < 14; i++) {
-		for (int j = 0; j < 64; j++) {
-			searchHistory[i][j] = 0;
-		}
-	}
-	// Clear Killer Moves
-	for (int i = 0; i < 2; i++) {
-		for (int j = 0; j < MAX_DEPTH; j++) {
-			searchKillers[i][j] = 0;
-		}
-	}
-
 	// Note: ply and histPly are usually reset during parsePosition/makeMove logic
 	ply = 0;
 	histPly = 0;
 }
 
-BoardState Board::makeNullMove(){
+BoardState Board::makeNullMove(bool prefetchTT){
 	BoardState undo = BoardState(state);
 	undo.zKey = zKey;
 	
@@ -95,6 +83,9 @@ BoardState Board::makeNullMove(){
 	zKey = Zobrist::xorSide(zKey);
 	state.currentPlayer = side^1;
 
+	if (prefetchTT)
+		hashTable->prefetch(zKey);
+
 	histPly++;
 	ply++;
 
@@ -119,7 +110,7 @@ void Board::undoNullMove(BoardState undo){
 //Invalid board state
 static BoardState invalidState;
 
-BoardState Board::makeMove(int move){
+BoardState Board::makeMove(int move, bool prefetchTT){
 	BoardState undo = BoardState(state);
 	undo.valid = true;
 	undo.zKey = zKey;
@@ -285,6 +276,10 @@ BoardState Board::makeMove(int move){
 
 	//set castle
 	zKey = Zobrist::xorCastle(zKey, state.castleKey);
+
+	//the child will probe this bucket, overlap the load with the legality check
+	if (prefetchTT)
+		hashTable->prefetch(zKey);
 	
 	histPly++;
 	ply++;
@@ -26,6 +26,7 @@ void EvalFEN::eval(std::string inputPath, std::string outputPath, int depth) {
 
     // 2. Setup Board and Hash
     HashTable hashTable;
+    SearchContext ctx;
     std::string line;
 
     // Optional: Write CSV Header
@@ -42,7 +43,8 @@ void EvalFEN::eval(std::string inputPath, std::string outputPath, int depth) {
         // Run Search
         // Use a large timeout (e.g., 5000ms) to ensure depth is reached, 
         // or remove time check inside getScore entirely.
-        int score = Search::iterativeDeepeningScore(board, depth, 5000, false);
+        ctx.clearStop();
+        int score = Search::iterativeDeepeningScore(ctx, board, depth, 5000, false);
 
         // Filter invalid searches
         if (score == Search::INVALID_SCORE) {
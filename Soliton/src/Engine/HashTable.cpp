@@ -1,72 +1,372 @@
 #include "Engine/HashTable.h"
 #include "Engine/Move.h"
 #include <assert.h>
-#include "Engine/MoveGen.h"
+#include "Engine/Search.h"
+#include "Engine/Zobrist.h"
 #include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
-BoardState HashTable::undoList[Board::MAX_DEPTH];
 
 
 void HashTable::initHash(int size){
-	numEntries = (size * 0x100000)/sizeof(HashEntry);
+	freeTable();
+	long long start = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
 
-	//if not power of two already
-	if (numEntries & (numEntries - 1)) {
+	numBuckets = ((U64)size * 0x100000)/sizeof(HashBucket);
 
-        numEntries--;
-        for (int i = 1; i < 32; i = i*2)
-            numEntries |= numEntries >> i;
-        numEntries++;
-        numEntries>>= 1;
-    }
-    numEntries_1 = numEntries - 1;
-    table = new HashEntry[numEntries];
+	//if not power of two already
+	if (numBuckets & (numBuckets - 1)) {
 
-    for (int i = 0; i < numEntries; i++){
-    	table[i] = HashEntry();    	
+        numBuckets--;
+        for (int i = 1; i < 64; i = i*2)
+            numBuckets |= numBuckets >> i;
+        numBuckets++;
+        numBuckets>>= 1;
     }
+    numBuckets_1 = numBuckets - 1;
+    numEntries = (U64)numBuckets * HashBucket::SIZE;
+    allocate((U64)numBuckets * sizeof(HashBucket));
+    clearParallel();
+    resetGenerations();
+    stats.reset();
 
-    newWrite = 0;
-    overWrite = 0;
-    hit = 0;
-    cut = 0;
-    std::cout << "Hash Table size: " << numEntries * sizeof(HashEntry)/0x100000 << " MB" << std::endl;
+	long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count() - start;
+    std::cout << "Hash Table size: " << (U64)numBuckets * sizeof(HashBucket)/0x100000 << " MB"
+    	<< ", allocated in " << elapsed << " ms, " << pageInfo() << std::endl;
 }
 
 HashTable::HashTable(int sizeMB){
+	table = nullptr;
 	initHash(sizeMB);
 }
 
 HashTable::HashTable(){
+	table = nullptr;
 	initHash(DEFAULT_SIZE);
 }
 
+HashTable::~HashTable(){
+	freeTable();
+}
+
+// Linux: explicit hugetlb pages when the system has them reserved, otherwise
+// 2 MB aligned memory with a transparent huge page hint. Elsewhere plain
+// page aligned memory.
+void HashTable::allocate(U64 bytes){
+	hugeTLB = false;
+#if defined(_WIN32)
+	allocBytes = bytes;
+	table = (HashBucket*)VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#elif defined(__linux__)
+	allocBytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+	void *mem = mmap(NULL, allocBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (mem != MAP_FAILED){
+		hugeTLB = true;
+	} else {
+		mem = std::aligned_alloc(HUGE_PAGE_SIZE, allocBytes);
+		if (mem)
+			madvise(mem, allocBytes, MADV_HUGEPAGE);
+	}
+	table = (HashBucket*)mem;
+#else
+	allocBytes = bytes;
+	table = (HashBucket*)std::aligned_alloc(alignof(HashBucket), bytes);
+#endif
+	if (!table){
+		std::cerr << "Error: could not allocate " << bytes / 0x100000 << " MB for the hash table" << std::endl;
+		exit(1);
+	}
+}
+
+void HashTable::freeTable(){
+	if (!table)
+		return;
+#if defined(_WIN32)
+	VirtualFree(table, 0, MEM_RELEASE);
+#elif defined(__linux__)
+	if (hugeTLB)
+		munmap(table, allocBytes);
+	else
+		std::free(table);
+#else
+	std::free(table);
+#endif
+	table = nullptr;
+}
+
+// Zeroes the table with one thread per core. This is also the first touch of
+// the pages, so they get faulted in here rather than during the search.
+void HashTable::clearParallel(){
+	int numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	U64 chunk = (allocBytes / numThreads + 4095) & ~(U64)4095;
+	std::vector<std::thread> workers;
+
+	for (int i = 0; i < numThreads; i++){
+		U64 begin = std::min(allocBytes, chunk * i);
+		U64 end = std::min(allocBytes, begin + chunk);
+		workers.push_back(std::thread([this, begin, end](){
+			std::memset((char*)table + begin, 0, end - begin);
+		}));
+	}
+	for (auto& w : workers)
+		w.join();
+}
+
+std::string HashTable::pageInfo(){
+#if defined(__linux__)
+	if (hugeTLB)
+		return "page size 2 MB (hugetlb)";
+
+	//find our mapping in smaps and read how much of it is backed by huge pages
+	std::ifstream smaps("/proc/self/smaps");
+	std::string line;
+	U64 addr = (U64)table;
+	bool inTable = false;
+
+	while (std::getline(smaps, line)){
+		U64 lo, hi;
+		if (sscanf(line.c_str(), "%" SCNx64 "-%" SCNx64, &lo, &hi) == 2 && line.find(':') > line.find(' ')){
+			inTable = addr >= lo && addr < hi;
+		}
+		else if (inTable && line.find("AnonHugePages:") == 0){
+			U64 kb = 0;
+			sscanf(line.c_str(), "AnonHugePages: %" SCNu64, &kb);
+			if (kb > 0)
+				return "page size 2 MB (transparent, " + std::to_string(kb / 1024) + " MB backed)";
+			break;
+		}
+	}
+#endif
+	return "page size 4 KB";
+}
+
+U64 HashEntry::pack(U64 zKey, int move16, int score, int depth, int flags, int generation){
+	assert(move16 >= 0 && move16 <= 0xFFFF);
+	return (U64)move16 | ((U64)(uint16_t)score << 16) | ((U64)(uint8_t)depth << 32) | ((U64)flags << 40)
+		| ((U64)(generation & GENERATION_MASK) << 42) | (zKey & 0xFFFF000000000000ULL);
+}
+
+void HashTable::newSearch(){
+	bumpGeneration(false);
+}
+
+// Entries keep 6 bits of the generation, so 64 bumps after it was written an
+// entry looks current again. That does no harm to entries of a live search,
+// but the ones a reset made stale must not come back: once the oldest entry
+// could wrap while stale ones may be left, the entries that would be stale
+// after the bump are emptied first.
+// Contexts sharing the table may bump at the same time, so both counters
+// change by compare-exchange and no bump is lost. The sweep check is redone
+// whenever another bump got in first, and always precedes the bump it protects.
+void HashTable::bumpGeneration(bool reset){
+	int current = generation.load();
+	int next;
+	do {
+		next = current + 1;
+		int newLiveAge = reset ? 0 : std::min(liveAge + 1, HashEntry::GENERATION_MASK - 1);
+		if (reset)
+			resetGeneration = next;
+		if (next - oldestGeneration > HashEntry::GENERATION_MASK && resetGeneration > oldestGeneration){
+			sweep(newLiveAge - 1);
+			oldestGeneration = next - newLiveAge;
+		}
+	} while (!generation.compare_exchange_weak(current, next));
+
+	if (reset){
+		liveAge = 0;
+		return;
+	}
+	int age = liveAge.load();
+	while (!liveAge.compare_exchange_weak(age, std::min(age + 1, HashEntry::GENERATION_MASK - 1)));
+}
+
+void HashTable::resetGenerations(){
+	generation = 0;
+	liveAge = 0;
+	oldestGeneration = 0;
+	resetGeneration = 0;
+}
+
+// One thread per core like clearParallel, but entry by entry and atomic, so
+// that searches still running on the table are safe
+void HashTable::sweep(int maxAge){
+	int numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	U64 chunk = (numBuckets + numThreads - 1) / numThreads;
+	int generation = this->generation;
+	std::vector<std::thread> workers;
+
+	for (int i = 0; i < numThreads; i++){
+		U64 begin = std::min<U64>(numBuckets, chunk * i);
+		U64 end = std::min<U64>(numBuckets, begin + chunk);
+		workers.push_back(std::thread([this, begin, end, generation, maxAge](){
+			for (U64 b = begin; b < end; b++){
+				for (int j = 0; j < HashBucket::SIZE; j++){
+					U64 data = table[b].entries[j].data.load(std::memory_order_relaxed);
+					if (data != 0 && data != HashEntry::BUSY && HashEntry::age(data, generation) > maxAge)
+						table[b].entries[j].data.compare_exchange_strong(data, 0, std::memory_order_relaxed);
+				}
+			}
+		}));
+	}
+	for (auto& w : workers)
+		w.join();
+}
+
+// Replacement: an empty or stale slot or the same position first, otherwise
+// the entry with the lowest worth, where worth favours depth and exact bounds
+// and decays by 8 plies for every search since the entry was written. The
+// same position keeps a deeper entry unless the new one is exact.
+// A writer claims its slot by swapping the entry it chose for BUSY, so no two
+// writers change one eval at the same time. A slot claimed or changed by
+// another thread is left to it and the store is dropped.
+int HashTable::store(U64 zKey, int move16, int score, int flags, int depth, int eval){
+	HashBucket& bucket = table[zKey & numBuckets_1];
+	HashEntry *entries = bucket.entries;
+	HashEntry *replace = nullptr;
+	int generation = this->generation.load(std::memory_order_relaxed);
+	int liveAge = this->liveAge.load(std::memory_order_relaxed);
+	int worst = 0x7FFFFFFF;
+	U64 old = 0;
+	U64 current = 0;
+	bool samePosition = false;
+
+	for (int i = 0; i < HashBucket::SIZE; i++){
+		U64 data = entries[i].data.load(std::memory_order_relaxed);
+		int age = HashEntry::age(data, generation);
+		if (data == HashEntry::BUSY)
+			continue;
+
+		//empty and stale slots are worth less than any live entry
+		if (data == 0 || age > liveAge){
+			if (worst != -0x7FFFFFFF){
+				worst = -0x7FFFFFFF;
+				replace = &entries[i];
+				old = 0;
+				current = data;
+			}
+			continue;
+		}
+		if (HashEntry::matches(data, zKey)){
+			replace = &entries[i];
+			old = current = data;
+			samePosition = true;
+			break;
+		}
+
+		int worth = HashEntry::depth(data) - 8 * age + (HashEntry::flags(data) == HFEXACT ? 2 : 0);
+		if (worth < worst){
+			worst = worth;
+			replace = &entries[i];
+			old = current = data;
+		}
+	}
+
+	//a shallower bound, from quiescence say, must not replace a deeper search
+	//of the same position
+	if (samePosition && depth < HashEntry::depth(old) && flags != HFEXACT)
+		return STORE_SAME;
+
+	if (!replace || !replace->data.compare_exchange_strong(current, HashEntry::BUSY, std::memory_order_relaxed))
+		return STORE_DROPPED;
+	//a reader that sees the new eval sees BUSY or a later entry after it
+	std::atomic_thread_fence(std::memory_order_release);
+
+	//keep the old best move and eval of the same position when we have none
+	if (move16 == Move::NO_MOVE && samePosition)
+		move16 = HashEntry::move(old);
+
+	if (eval != HashEntry::NO_EVAL || !samePosition)
+		bucket.evals[replace - entries].store((int16_t)eval, std::memory_order_relaxed);
+	replace->data.store(HashEntry::pack(zKey, move16, score, depth, flags, generation), std::memory_order_release);
+
+	if (samePosition)
+		return STORE_SAME;
+	return old == 0 ? STORE_NEW : STORE_OVERWRITE;
+}
+
+bool HashTable::probe(U64 zKey, int *move16, int *score, int *flags, int *depth, int *eval){
+	HashBucket& bucket = table[zKey & numBuckets_1];
+	HashEntry *entries = bucket.entries;
+	int generation = this->generation.load(std::memory_order_relaxed);
+	int liveAge = this->liveAge.load(std::memory_order_relaxed);
+
+	for (int i = 0; i < HashBucket::SIZE; i++){
+		U64 data = entries[i].data.load(std::memory_order_acquire);
+
+		if (!HashEntry::matches(data, zKey) || HashEntry::age(data, generation) > liveAge)
+			continue;
+
+		*move16 = HashEntry::move(data);
+		*score = HashEntry::score(data);
+		*flags = HashEntry::flags(data);
+		*depth = HashEntry::depth(data);
+		if (eval){
+			//writers hold the slot while they change the eval, so an entry that
+			//reads the same after the eval was read owns that eval
+			*eval = bucket.evals[i].load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (entries[i].data.load(std::memory_order_relaxed) != data)
+				*eval = HashEntry::NO_EVAL;
+		}
+		return true;
+	}
+	return false;
+}
+
 int HashTable::probePvMove(Board& board){
-	int index = (int)(board.zKey & board.hashTable->numEntries_1);
-	assert(index >= 0 && index <= board.hashTable->numEntries_1);
-	
-	if( board.hashTable->table[index].zKey == board.zKey) {
-		return board.hashTable->table[index].move;
+	int move16, score, flags, depth;
+	if (board.hashTable->probe(board.zKey, &move16, &score, &flags, &depth)) {
+		return Move::fromCompact(board, move16);
 	}
 	return Move::NO_MOVE;
 }
 
-bool HashTable::probeHashEntry(Board& board, int *move, int *score, int alpha, int beta, int depth) {
-	int index = (int)(board.zKey & board.hashTable->numEntries_1);
+bool HashTable::probeHashEntry(Board& board, int *move, int *score, int alpha, int beta, int depth,
+	int *entryDepth, int *entryFlags, int *entryEval) {
+	int move16, flags, ttDepth;
+	TTStats *stats = board.ttStats;
 
-	if(board.hashTable->table[index].zKey == board.zKey) {
-		*move = board.hashTable->table[index].move;
+	if (stats){
+		stats->probes++;
+		stats->depthProbes[TTStats::slot(depth)]++;
+	}
 
-		if(board.hashTable->table[index].depth >= depth){
-			board.hashTable->hit++;
+	if (board.hashTable->probe(board.zKey, &move16, score, &flags, &ttDepth, entryEval)) {
+		*move = Move::fromCompact(board, move16);
+		if (entryDepth) *entryDepth = ttDepth;
+		if (entryFlags) *entryFlags = flags;
+		if (stats){
+			stats->hits++;
+			stats->depthHits[TTStats::slot(depth)]++;
+		}
+
+		if(ttDepth >= depth){
 
-			*score = board.hashTable->table[index].score;
 			if(*score > ISMATE) 
 				*score -= board.ply;
             else if(*score < -ISMATE) 
             	*score += board.ply;
 
-            switch(board.hashTable->table[index].flags) {
+            switch(flags) {
                 assert(*score >= -Search::INFINITE && *score <= Search::INFINITE);
 
                 case HFALPHA: 
@@ -78,10 +378,12 @@ bool HashTable::probeHashEntry(Board& board, int *move, int *score, int alpha, i
                 case HFBETA: 
                 	if(*score >= beta) {
                     	*score = beta;
+                    	if (stats) stats->cutoffs++;
                     	return true;
                     }
                     break;
                 case HFEXACT:
+                    if (stats) stats->cutoffs++;
                     return true;
                     break;
                 default: assert(false); 
@@ -92,84 +394,295 @@ bool HashTable::probeHashEntry(Board& board, int *move, int *score, int alpha, i
 	return false;
 }
 
-void HashTable::storeHashEntry(Board& board, const int move, int score, const int flags, const int depth){
+void HashTable::storeHashEntry(Board& board, const int move, int score, const int flags, const int depth, int eval){
 	if (depth >= Board::MAX_DEPTH)
 		return;
 
-	int index = (int)(board.zKey & board.hashTable->numEntries_1);
-
-	assert(index >= 0 && index <= board.hashTable->numEntries_1);
 	//assert(depth >=1 && depth <= Board::MAX_DEPTH);
     assert(flags >= HFNONE && flags <= HFEXACT);
     assert(score >= -Search::INFINITE && score <= Search::INFINITE);
     assert(board.ply >=0 && board.ply < Board::MAX_DEPTH);
 	
-	if(board.hashTable->table[index].zKey == 0) {
-		board.hashTable->newWrite++;
-	} else {
-		board.hashTable->overWrite++;
-	}
-	
 	if(score > ISMATE) 
 		score += board.ply;
     else if(score < -ISMATE) 
     	score -= board.ply;
-	
-	board.hashTable->table[index].move = move;
-    board.hashTable->table[index].zKey = board.zKey;
-	board.hashTable->table[index].flags = flags;
-	board.hashTable->table[index].score = score;
-	board.hashTable->table[index].depth = depth;
+
+	int result = board.hashTable->store(board.zKey, Move::toCompact(move), score, flags, depth, eval);
+
+	if (TTStats *stats = board.ttStats){
+		stats->stores++;
+		if (result == STORE_NEW)
+			stats->newWrites++;
+		else if (result == STORE_SAME)
+			stats->sameWrites++;
+		else if (result == STORE_OVERWRITE)
+			stats->overWrites++;
+		else
+			stats->dropped++;
+	}
 }
 
-int HashTable::getPVLine(int depth, Board& board){
-	int move = HashTable::probePvMove(board);
-	int count = 0;
+void HashTable::reset(){
+	bumpGeneration(true);
+	stats.reset();
+}
 
-	while (move != Move::NO_MOVE && count < depth){
+void HashTable::clear(){
+	clearParallel();
+	resetGenerations();
+	stats.reset();
+}
 
-		assert(count < Board::MAX_DEPTH);
+// Samples the first 1000 entries, like the usual UCI hashfull. Only entries of
+// the current generation count, so it shows how much of the table the running
+// search has used.
+int HashTable::hashfull(){
+	U64 buckets = std::min<U64>(numBuckets, 1000 / HashBucket::SIZE);
+	int used = 0;
 
-		if (moveExists(board, move, board.state.currentPlayer)) {
-			BoardState undo = board.makeMove(move);			
-			undoList[count] = undo;
-			board.pvArray[count++] = move;				
-		} else{
-			break;
+	for (U64 i = 0; i < buckets; i++){
+		for (int j = 0; j < HashBucket::SIZE; j++){
+			U64 data = table[i].entries[j].data.load(std::memory_order_relaxed);
+			if (data != 0 && HashEntry::age(data, generation) == 0)
+				used++;
 		}
-		move = HashTable::probePvMove(board);
 	}
+	return (int)(used * 1000 / (buckets * HashBucket::SIZE));
+}
 
-	//undo
-	for (int i = count - 1; i >= 0; i--)
-		board.undoMove(board.pvArray[i], undoList[i]);
+void TTStats::reset(){
+	probes = hits = cutoffs = 0;
+	stores = newWrites = sameWrites = overWrites = dropped = 0;
+	searches = nodes = qnodes = 0;
+	for (int i = 0; i < DEPTHS; i++){
+		depthProbes[i] = 0;
+		depthHits[i] = 0;
+	}
+}
 
-	return count;
+void TTStats::add(const TTStats& other){
+	probes += other.probes;
+	hits += other.hits;
+	cutoffs += other.cutoffs;
+	stores += other.stores;
+	newWrites += other.newWrites;
+	sameWrites += other.sameWrites;
+	overWrites += other.overWrites;
+	dropped += other.dropped;
+	searches += other.searches;
+	nodes += other.nodes;
+	qnodes += other.qnodes;
+	for (int i = 0; i < DEPTHS; i++){
+		depthProbes[i] += other.depthProbes[i];
+		depthHits[i] += other.depthHits[i];
+	}
 }
 
-bool HashTable::moveExists(Board& board, int move, int side){	
-	int ks = board.kingSQ[side];
-	bool atCheck = MoveGen::isSquareAttacked(&board, ks, side^1);
-	MoveList moves;
-	MoveGen::pseudoLegalMoves(&board, side, moves, atCheck);
-	U64 pinned = MoveGen::pinnedBB(&board, side, ks);
+static std::string percent(U64 part, U64 total){
+	char buf[16];
+	snprintf(buf, sizeof(buf), "%.1f%%", total ? 100.0 * part / total : 0.0);
+	return buf;
+}
 
-	for (int i = 0; i < moves.size(); i++){
-		if (moves.get(i) == move && MoveGen::isLegalMove(&board, moves.get(i), side, atCheck, pinned)){
-			return true;
-		}
+// A probe checks 16 key bits against every live entry of its bucket, so each
+// probe of an unstored position matches a wrong entry with probability about
+// liveSlots / 65536. The estimate uses the sampled fill as the live fraction.
+void HashTable::printStats(){
+	int full = hashfull();
+	double falseHits = (double)stats.probes * HashBucket::SIZE * full / 1000.0 / 65536.0;
+
+	std::cout << "searches " << stats.searches << ", nodes " << stats.nodes << " (quiescence " << stats.qnodes << ")" << std::endl;
+	std::cout << "hashfull " << full << " permille of " << numEntries << " entries" << std::endl;
+	std::cout << "probes " << stats.probes << ", hits " << stats.hits << " (" << percent(stats.hits, stats.probes)
+		<< "), cutoffs " << stats.cutoffs << " (" << percent(stats.cutoffs, stats.probes) << ")" << std::endl;
+	std::cout << "stores " << stats.stores << ", new " << stats.newWrites << " (" << percent(stats.newWrites, stats.stores)
+		<< "), same position " << stats.sameWrites << " (" << percent(stats.sameWrites, stats.stores)
+		<< "), overwrites " << stats.overWrites << " (" << percent(stats.overWrites, stats.stores)
+		<< "), dropped " << stats.dropped << " (" << percent(stats.dropped, stats.stores) << ")" << std::endl;
+	char collisions[32];
+	snprintf(collisions, sizeof(collisions), "%.2f", falseHits);
+	std::cout << "estimated key collisions " << collisions << std::endl;
+
+	std::cout << "depth      probes        hits    hit%" << std::endl;
+	for (int i = 0; i < TTStats::DEPTHS; i++){
+		if (stats.depthProbes[i] == 0)
+			continue;
+		char line[80];
+		snprintf(line, sizeof(line), "%s%-4d %11" PRIu64 " %11" PRIu64 " %7s", i == TTStats::DEPTHS - 1 ? ">=" : "  ", i,
+			stats.depthProbes[i], stats.depthHits[i], percent(stats.depthHits[i], stats.depthProbes[i]).c_str());
+		std::cout << line << std::endl;
 	}
-	return false;
 }
 
-void HashTable::reset(){
-	for (U64 i = 0; i < numEntries; i++){
-		table[i].zKey = 0;
-	    table[i].move = 0;
-	    table[i].depth = 0;
-	    table[i].score = 0;
-	    table[i].flags = 0;
+// Snapshot file: this header followed by the raw bucket array
+struct SnapshotHeader{
+	char magic[8];
+	U64 zobristChecksum;
+	U32 format;
+	U32 bucketSize;
+	U64 numBuckets;
+	U32 generation;
+	U32 liveAge;
+};
+
+static const char SNAPSHOT_MAGIC[8] = {'S', 'O', 'L', 'T', 'T', 'S', 'N', 'P'};
+
+bool HashTable::save(std::string file){
+	std::ofstream out(file, std::ios::binary);
+	if (!out.is_open()){
+		std::cerr << "Error: could not create " << file << std::endl;
+		return false;
 	}
-	newWrite = 0;
+
+	SnapshotHeader h;
+	std::memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+	h.zobristChecksum = Zobrist::checksum();
+	h.format = HashEntry::FORMAT;
+	h.bucketSize = HashBucket::SIZE;
+	h.numBuckets = numBuckets;
+	h.generation = generation;
+	h.liveAge = liveAge;
+
+	out.write((const char*)&h, sizeof(h));
+	out.write((const char*)table, (std::streamsize)numBuckets * sizeof(HashBucket));
+	if (!out.good()){
+		std::cerr << "Error: could not write " << file << std::endl;
+		return false;
+	}
+	std::cout << "info string saved hash to " << file << std::endl;
+	return true;
 }
 
+bool HashTable::load(std::string file){
+	U64 tableBytes = (U64)numBuckets * sizeof(HashBucket);
+	SnapshotHeader h;
+
+#if defined(__linux__)
+	int fd = open(file.c_str(), O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0 || (U64)st.st_size < sizeof(h)){
+		if (fd >= 0) close(fd);
+		std::cerr << "Error: could not open " << file << std::endl;
+		return false;
+	}
+	void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mem == MAP_FAILED){
+		std::cerr << "Error: could not map " << file << std::endl;
+		return false;
+	}
+	std::memcpy(&h, mem, sizeof(h));
+	bool sizeOk = (U64)st.st_size == sizeof(h) + h.numBuckets * sizeof(HashBucket);
+#else
+	std::ifstream in(file, std::ios::binary);
+	if (!in.is_open() || !in.read((char*)&h, sizeof(h))){
+		std::cerr << "Error: could not open " << file << std::endl;
+		return false;
+	}
+	bool sizeOk = true;
+#endif
+
+	std::string error;
+	if (std::memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0 || !sizeOk)
+		error = "not a hash snapshot";
+	else if (h.zobristChecksum != Zobrist::checksum())
+		error = "snapshot was made with different zobrist keys";
+	else if (h.format != HashEntry::FORMAT || h.bucketSize != HashBucket::SIZE)
+		error = "snapshot has a different entry format";
+	else if (h.numBuckets != numBuckets)
+		error = "snapshot is " + std::to_string(h.numBuckets * sizeof(HashBucket) / 0x100000) + " MB, set Hash to that size first";
+
+	if (error.empty()){
+#if defined(__linux__)
+		std::memcpy((void*)table, (const char*)mem + sizeof(h), tableBytes);
+#else
+		in.read((char*)table, (std::streamsize)tableBytes);
+		if (!in)
+			error = "snapshot is truncated";
+#endif
+	}
+#if defined(__linux__)
+	munmap(mem, st.st_size);
+#endif
+
+	if (!error.empty()){
+		std::cerr << "Error: " << file << ": " << error << std::endl;
+		return false;
+	}
+	//the snapshot's stale entries go, what is left is as if freshly searched
+	generation = h.generation;
+	liveAge = h.liveAge;
+	sweep(liveAge);
+	oldestGeneration = generation - liveAge;
+	resetGeneration = generation - liveAge;
+	std::cout << "info string loaded hash from " << file << std::endl;
+	return true;
+}
+
+// Stress keys come from a small pool so that many threads keep hitting the
+// same slots with different keys.
+static U64 stressKey(U64 i){
+	U64 z = i * 0x9E3779B97F4A7C15ULL + 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+// Entry contents are a pure function of the key bits the table can see (bucket
+// index and key check), so any probe hit whose fields do not match that
+// function was assembled from two different writes.
+static void stressEntry(U64 key, U64 bucketMask, int& move, int& score, int& flags, int& depth, int& eval){
+	U64 visible = (key & bucketMask) ^ (key >> 48);
+	move = (int)(visible & 0xFFFF);
+	score = (int)(visible % 60001) - 30000;
+	flags = 1 + (int)((visible >> 3) % 3);
+	depth = (int)((visible >> 5) % Board::MAX_DEPTH);
+	eval = (int)(visible % 8001) - 4000;
+}
+
+void HashTable::stressTest(int numThreads, int seconds){
+	//small table so that threads collide on the same entries all the time
+	HashTable tt(1);
+	U64 poolSize = (U64)tt.numEntries * 4;
+	std::atomic<bool> done(false);
+	std::atomic<long long> probes(0), hits(0), corrupted(0);
+
+	auto worker = [&](int id){
+		std::mt19937_64 rng(id + 1);
+		long long p = 0, h = 0, c = 0;
+
+		while (!done.load(std::memory_order_relaxed)){
+			int move, score, flags, depth, eval;
+			U64 key = stressKey(rng() % poolSize);
+			stressEntry(key, tt.numBuckets_1, move, score, flags, depth, eval);
+			tt.store(key, move, score, flags, depth, eval);
+
+			U64 other = stressKey(rng() % poolSize);
+			p++;
+			if (tt.probe(other, &move, &score, &flags, &depth, &eval)){
+				h++;
+				int em, es, ef, ed, ee;
+				stressEntry(other, tt.numBuckets_1, em, es, ef, ed, ee);
+				//a dropped eval is fine, a wrong one is not
+				if (move != em || score != es || flags != ef || depth != ed || (eval != HashEntry::NO_EVAL && eval != ee))
+					c++;
+			}
+		}
+		probes += p;
+		hits += h;
+		corrupted += c;
+	};
+
+	std::vector<std::thread> workers;
+	for (int i = 0; i < numThreads; i++)
+		workers.push_back(std::thread(worker, i));
+
+	std::this_thread::sleep_for(std::chrono::seconds(seconds));
+	done = true;
+	for (auto& w : workers)
+		w.join();
+
+	std::cout << "TT stress: " << numThreads << " threads, " << probes << " probes, "
+		<< hits << " hits, " << corrupted << " corrupted" << std::endl;
+}
\ No newline at end of file
@@ -34,6 +34,54 @@ int Move::promoteTo(int move){
 	return move >> 17 & 0xF;
 }
 
+static const int COMPACT_PROMO = 1;
+static const int COMPACT_EP = 2;
+static const int COMPACT_CASTLE = 3;
+static const int COMPACT_PIECES[4] = {Board::KNIGHT, Board::BISHOP, Board::ROOK, Board::QUEEN};
+
+int Move::toCompact(int move){
+	if (move == NO_MOVE)
+		return NO_MOVE;
+
+	int kind = 0;
+	int piece = 0;
+	int promote = promoteTo(move);
+
+	if (isCastle(move))
+		kind = COMPACT_CASTLE;
+	else if (isEP(move))
+		kind = COMPACT_EP;
+	else if (promote != Board::EMPTY){
+		kind = COMPACT_PROMO;
+		piece = (promote & ~1) / 2 - 2;
+	}
+	return from(move) | (to(move) << 6) | (piece << 12) | (kind << 14);
+}
+
+//captured piece and pawn jump flag are recovered from the board
+int Move::fromCompact(const Board& board, int move16){
+	if (move16 == NO_MOVE)
+		return NO_MOVE;
+
+	int from = move16 & 0x3F;
+	int to = (move16 >> 6) & 0x3F;
+	int piece = (move16 >> 12) & 0x3;
+	int kind = (move16 >> 14) & 0x3;
+	int side = board.state.currentPlayer;
+
+	if (kind == COMPACT_CASTLE)
+		return get_move(from, to, 0, 0, 0, 0, CASTLE_FLAG);
+	if (kind == COMPACT_EP)
+		return get_move(from, to, 0, 0, EP_FLAG, 0, 0);
+	if (kind == COMPACT_PROMO)
+		return get_move(from, to, board.board[to], COMPACT_PIECES[piece] | side, 0, 0, 0);
+
+	int move = get_move(from, to, board.board[to], 0, 0, 0, 0);
+	if ((board.board[from] & ~1) == Board::PAWN && (to - from == 16 || from - to == 16))
+		move |= PAWN_JUMP_FLAG;
+	return move;
+}
+
 std::string Move::toNotation(int move){
 	std::string mv = "";
 
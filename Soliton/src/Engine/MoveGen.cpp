@@ -662,3 +662,114 @@ void MoveGen::getEvasions(const Board* board, int side, MoveList& moves, U64 occ
 	//queenMoves(board, side, moves);
 }
 
+//Non captures without promotions, the move picker gets those with the captures
+void MoveGen::pseudoLegalQuietMoves(Board* board, int side, MoveList& moves){
+	U64 occup = board->bitboards[Board::WHITE] | board->bitboards[Board::BLACK];
+	U64 empty = ~occup;
+
+	U64 pawnBB = board->bitboards[Board::PAWN | side];
+	U64 pushes = BitBoardGen::circular_lsh(pawnBB, push_dir[side]) & empty;
+	U64 dpushes = BitBoardGen::circular_lsh(pushes & BitBoardGen::BITBOARD_RANKS[push_ranks[side]], push_dir[side]) & empty;
+	pushes&= ~BitBoardGen::BITBOARD_RANKS[promo_ranks[side]];
+
+	if (pushes)
+		addMovesForDir(board, side, pushes, diff_push, Move::NO_FLAGS, moves);
+	if (dpushes)
+		addMovesForDir(board, side, dpushes, diff_jump, Move::PAWN_JUMP_FLAG, moves);
+
+	U64 kn = board->bitboards[Board::KNIGHT | side];
+	while (kn){
+		int from = numberOfTrailingZeros(kn);
+		add_moves(board, from, BitBoardGen::BITBOARD_KNIGHT_ATTACKS[from] & empty, Move::NO_FLAGS, moves);
+		kn&= kn - 1;
+	}
+	U64 bishops = board->bitboards[Board::BISHOP | side];
+	while (bishops){
+		int from = numberOfTrailingZeros(bishops);
+		add_moves(board, from, Magic::bishopAttacksFrom(occup, from) & empty, Move::NO_FLAGS, moves);
+		bishops&= bishops - 1;
+	}
+	U64 rooks = board->bitboards[Board::ROOK | side];
+	while (rooks){
+		int from = numberOfTrailingZeros(rooks);
+		add_moves(board, from, Magic::rookAttacksFrom(occup, from) & empty, Move::NO_FLAGS, moves);
+		rooks&= rooks - 1;
+	}
+	U64 queens = board->bitboards[Board::QUEEN | side];
+	while (queens){
+		int from = numberOfTrailingZeros(queens);
+		add_moves(board, from, Magic::queenAttacksFrom(occup, from) & empty, Move::NO_FLAGS, moves);
+		queens&= queens - 1;
+	}
+	int ks = board->kingSQ[side];
+	add_moves(board, ks, BitBoardGen::BITBOARD_KING_ATTACKS[ks] & empty, Move::NO_FLAGS, moves);
+
+	if (can_castle_ks(board, side, occup))
+		moves.add(Move::get_move(0, side, 0, 0, 0, 0, Move::CASTLE_FLAG));
+	if (can_castle_qs(board, side, occup))
+		moves.add(Move::get_move(1, side, 0, 0, 0, 0, Move::CASTLE_FLAG));
+}
+
+//Would the generator produce this move here? Used for hash and killer moves,
+//which may come from another position. Legality is left to makeMove.
+bool MoveGen::isPseudoLegal(Board* board, int move, int side, bool atCheck){
+	if (move == Move::NO_MOVE)
+		return false;
+
+	int from = Move::from(move);
+	int to = Move::to(move);
+	U64 occup = board->bitboards[Board::WHITE] | board->bitboards[Board::BLACK];
+
+	if (Move::isCastle(move)){
+		if (atCheck || to != side || (move & ~(Move::CASTLE_FLAG | 0xFFF)) != 0)
+			return false;
+		if (from == 0)
+			return can_castle_ks(board, side, occup);
+		return from == 1 && can_castle_qs(board, side, occup);
+	}
+
+	int piece = board->board[from];
+	int capt = Move::captured(move);
+	int promote = Move::promoteTo(move);
+
+	if (piece == Board::EMPTY || (piece & 1) != side)
+		return false;
+
+	if (Move::isEP(move)){
+		int ep = board->state.epSquare;
+		return piece == (Board::PAWN | side) && ep != 0 && to == ep && capt == Board::EMPTY && promote == Board::EMPTY
+			&& !Move::isPJ(move) && (BitBoardGen::BITBOARD_PAWN_ATTACKS[side][from] & BitBoardGen::SQUARES[to]);
+	}
+
+	//the captured piece is part of the move, it must be what stands there now
+	if (capt != board->board[to] || capt == (Board::KING | (side ^ 1)) || (capt != Board::EMPTY && (capt & 1) == side))
+		return false;
+
+	if (piece == (Board::PAWN | side)){
+		bool promoRank = (BitBoardGen::SQUARES[to] & BitBoardGen::BITBOARD_RANKS[promo_ranks[side]]) != 0;
+		if (promoRank != (promote != Board::EMPTY))
+			return false;
+		if (promote != Board::EMPTY && ((promote & ~1) < Board::KNIGHT || (promote & ~1) > Board::QUEEN || (promote & 1) != side))
+			return false;
+
+		if (capt != Board::EMPTY)
+			return !Move::isPJ(move) && (BitBoardGen::BITBOARD_PAWN_ATTACKS[side][from] & BitBoardGen::SQUARES[to]);
+		if (Move::isPJ(move))
+			return to == from + diff_jump[side] && board->board[from + diff_push[side]] == Board::EMPTY
+				&& ((from + diff_push[side]) >> 3) == push_ranks[side];
+		return to == from + diff_push[side];
+	}
+
+	if (promote != Board::EMPTY || Move::isPJ(move))
+		return false;
+
+	U64 targets;
+	switch (piece & ~1){
+		case Board::KNIGHT: targets = BitBoardGen::BITBOARD_KNIGHT_ATTACKS[from]; break;
+		case Board::BISHOP: targets = Magic::bishopAttacksFrom(occup, from); break;
+		case Board::ROOK: targets = Magic::rookAttacksFrom(occup, from); break;
+		case Board::QUEEN: targets = Magic::queenAttacksFrom(occup, from); break;
+		default: targets = BitBoardGen::BITBOARD_KING_ATTACKS[from]; break;
+	}
+	return (targets & BitBoardGen::SQUARES[to]) != 0;
+}
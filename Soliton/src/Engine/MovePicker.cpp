@@ -0,0 +1,227 @@
+#include "Engine/MovePicker.h"
+#include "Engine/MoveGen.h"
+#include "Engine/Search.h"
+#include "Engine/Evaluation.h"
+#include <cstring>
+#include <mutex>
+
+int MovePicker::MVV_LVA[14][14];
+
+void MovePicker::init(){
+	//searches in several contexts may start at the same time
+	static std::once_flag done;
+	std::call_once(done, [](){
+		int values[] = { 0, 0, 100, 100, 200, 200, 300, 300, 400, 400, 500, 500, 600, 600 };
+		for (int v = 2; v < 14; v++){
+			for (int a = 2; a < 14; a++){
+				MVV_LVA[v][a] = values[v] + 10 - (values[a] / 100);
+			}
+		}
+	});
+}
+
+void HistoryTables::clear(){
+	memset(this, 0, sizeof(HistoryTables));
+}
+
+void HistoryTables::update(int16_t& entry, int bonus){
+	bonus = std::max(-MAX_HISTORY, std::min(bonus, MAX_HISTORY));
+	entry += bonus - entry * abs(bonus) / MAX_HISTORY;
+}
+
+int HistoryTables::bonus(int depth){
+	return std::min(64 * depth * depth, 2048);
+}
+
+int HistoryTables::piece(const Board& board, int move){
+	if (Move::isCastle(move))
+		return Board::KING | board.state.currentPlayer;
+	return board.board[Move::from(move)];
+}
+
+int HistoryTables::to(const Board& board, int move){
+	if (Move::isCastle(move))
+		return Board::CASTLE_SQS[Move::from(move)][board.state.currentPlayer][1];
+	return Move::to(move);
+}
+
+int HistoryTables::victim(const Board& board, int move){
+	return Move::isEP(move) ? (Board::PAWN | (board.state.currentPlayer ^ 1)) : Move::captured(move);
+}
+
+MovePicker::MovePicker(Board& board, const HistoryTables& history, const PieceToHistory* const cont[2], const int killers[2],
+	int counterMove, int ttMove, bool inCheck) : board(board), history(history){
+	side = board.state.currentPlayer;
+	this->inCheck = inCheck;
+	capturesOnly = false;
+	current = 0;
+	currentBad = 0;
+	this->killers[0] = killers[0];
+	this->killers[1] = killers[1];
+	this->counterMove = counterMove;
+	//the [0][0] row belongs to no move and is never updated
+	for (int i = 0; i < 2; i++)
+		this->cont[i] = cont != nullptr ? cont[i] : &history.continuation[0][0];
+
+	//hash moves can come from another position that shares the key bits
+	if (!MoveGen::isPseudoLegal(&board, ttMove, side, inCheck))
+		ttMove = Move::NO_MOVE;
+	this->ttMove = ttMove;
+
+	stage = inCheck ? EVASION_TT_MOVE : TT_MOVE;
+}
+
+MovePicker::MovePicker(Board& board, const HistoryTables& history, const int killers[2], int ttMove, bool inCheck)
+	: MovePicker(board, history, nullptr, killers, Move::NO_MOVE, ttMove, inCheck){
+	capturesOnly = !inCheck;
+	if (capturesOnly && isQuiet(this->ttMove))
+		this->ttMove = Move::NO_MOVE;
+}
+
+//MVV-LVA first, capture history only reorders captures of close value
+int MovePicker::captureScore(int move){
+	int piece = board.board[Move::from(move)];
+	int victim = HistoryTables::victim(board, move);
+	int score = MVV_LVA[victim][piece];
+	int promote = Move::promoteTo(move);
+	if (promote != Board::EMPTY)
+		score += abs(Evaluation::PIECE_VALUES[promote]);
+	return score * 16 + history.capture[piece][Move::to(move)][victim] / 8;
+}
+
+int MovePicker::quietScore(int move){
+	int piece = HistoryTables::piece(board, move);
+	int to = HistoryTables::to(board, move);
+	return history.quiet[piece][to] + (*cont[0])[piece][to] + (*cont[1])[piece][to];
+}
+
+void MovePicker::scoreCaptures(){
+	for (int i = 0; i < moves.size(); i++)
+		moves.setScore(i, captureScore(moves.get(i)));
+}
+
+void MovePicker::scoreQuiets(){
+	for (int i = 0; i < moves.size(); i++)
+		moves.setScore(i, quietScore(moves.get(i)));
+}
+
+void MovePicker::scoreEvasions(){
+	for (int i = 0; i < moves.size(); i++){
+		int move = moves.get(i);
+		if (!isQuiet(move))
+			moves.setScore(i, 10000000 + captureScore(move));
+		else if (move == killers[0])
+			moves.setScore(i, 9000000);
+		else if (move == killers[1])
+			moves.setScore(i, 8000000);
+		else
+			moves.setScore(i, quietScore(move));
+	}
+}
+
+bool MovePicker::isQuiet(int move){
+	return Move::captured(move) == Board::EMPTY && !Move::isEP(move) && Move::promoteTo(move) == Board::EMPTY;
+}
+
+bool MovePicker::isKiller(int move){
+	return move == killers[0] || move == killers[1];
+}
+
+int MovePicker::next(){
+	switch (stage){
+		case TT_MOVE:
+			stage = INIT_CAPTURES;
+			if (ttMove != Move::NO_MOVE)
+				return ttMove;
+			//fall through
+		case INIT_CAPTURES:
+			MoveGen::pseudoLegalCaptureMoves(&board, side, moves);
+			MoveGen::pawnPromotions(&board, side, moves, true);
+			scoreCaptures();
+			stage = GOOD_CAPTURES;
+			//fall through
+		case GOOD_CAPTURES:
+			while (current < moves.size()){
+				int move = moves.pickBest(current++);
+				if (move == ttMove)
+					continue;
+
+				//losing captures and underpromotions wait until after the quiets
+				int promote = Move::promoteTo(move);
+				bool bad = promote != Board::EMPTY ? (promote & ~1) != Board::QUEEN
+					: Search::isBadCapture(board, move, side);
+				if (bad){
+					if (!capturesOnly)
+						badCaptures.add(move);
+					continue;
+				}
+				return move;
+			}
+			if (capturesOnly){
+				stage = DONE;
+				return Move::NO_MOVE;
+			}
+			stage = KILLER_1;
+			//fall through
+		case KILLER_1:
+			stage = KILLER_2;
+			if (killers[0] != ttMove && isQuiet(killers[0])
+				&& MoveGen::isPseudoLegal(&board, killers[0], side, false))
+				return killers[0];
+			//fall through
+		case KILLER_2:
+			stage = COUNTER_MOVE;
+			if (killers[1] != ttMove && killers[1] != killers[0] && isQuiet(killers[1])
+				&& MoveGen::isPseudoLegal(&board, killers[1], side, false))
+				return killers[1];
+			//fall through
+		case COUNTER_MOVE:
+			stage = INIT_QUIETS;
+			if (counterMove != ttMove && !isKiller(counterMove) && isQuiet(counterMove)
+				&& MoveGen::isPseudoLegal(&board, counterMove, side, false))
+				return counterMove;
+			//fall through
+		case INIT_QUIETS:
+			moves.reset();
+			current = 0;
+			MoveGen::pseudoLegalQuietMoves(&board, side, moves);
+			scoreQuiets();
+			stage = QUIETS;
+			//fall through
+		case QUIETS:
+			while (current < moves.size()){
+				int move = moves.pickBest(current++);
+				if (move != ttMove && !isKiller(move) && move != counterMove)
+					return move;
+			}
+			stage = BAD_CAPTURES;
+			//fall through
+		case BAD_CAPTURES:
+			if (currentBad < badCaptures.size())
+				return badCaptures.get(currentBad++);
+			stage = DONE;
+			return Move::NO_MOVE;
+
+		case EVASION_TT_MOVE:
+			stage = INIT_EVASIONS;
+			if (ttMove != Move::NO_MOVE)
+				return ttMove;
+			//fall through
+		case INIT_EVASIONS:
+			MoveGen::getEvasions(&board, side, moves, board.bitboards[Board::WHITE] | board.bitboards[Board::BLACK]);
+			scoreEvasions();
+			stage = EVASIONS;
+			//fall through
+		case EVASIONS:
+			while (current < moves.size()){
+				int move = moves.pickBest(current++);
+				if (move != ttMove)
+					return move;
+			}
+			stage = DONE;
+			return Move::NO_MOVE;
+
+		default:
+			return Move::NO_MOVE;
+	}
+}
@@ -2,14 +2,66 @@
 #include "Engine/Evaluation.h"
 #include "Engine/MoveGen.h"
 #include "Engine/HashTable.h"
+#include "Engine/MovePicker.h"
 #include <iostream>
 #include <algorithm>
 #include <vector>
+#include <thread>
+#include <map>
+#include <cmath>
+#include <cassert>
+#include <cstdlib>
+#include <new>
+#include <mutex>
+
+#ifndef NDEBUG
+// Debug builds count heap allocations per thread, and every alphaBeta and
+// quiescence call asserts that it and its subtree made none.
+static thread_local long heapAllocations = 0;
+
+void* operator new(std::size_t size) {
+    heapAllocations++;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+struct NoAllocScope {
+    long start = heapAllocations;
+    ~NoAllocScope() { assert(heapAllocations == start && "heap allocation inside the search"); }
+};
+#define NO_ALLOC_SCOPE() NoAllocScope noAllocScope
+#else
+#define NO_ALLOC_SCOPE()
+#endif
+
+Search::Tunables Search::tune;
+int Search::reductions[Board::MAX_DEPTH][Search::LMR_MOVES];
+static std::once_flag reductionsInit;
+
+void SearchContext::stop() {
+    stopped = true;
+}
 
-Search::SearchParams Search::params;
+void SearchContext::clearStop() {
+    stopped = false;
+}
+
+void SearchContext::setMultiPV(int n) {
+    multiPV = std::max(1, std::min(n, Search::MAX_MULTI_PV));
+}
 
-void Search::stop() {
-    params.stopped = true;
+void SearchContext::setThreads(int n) {
+    numThreads = std::max(1, std::min(n, Search::MAX_THREADS));
+}
+
+long long SearchContext::totalNodes() const {
+    long long nodes = 0;
+    for (int i = 0; i < numThreads; i++)
+        nodes += threads[i].nodes.load(std::memory_order_relaxed);
+    return nodes;
 }
 
 // Helper to get current time in milliseconds
@@ -18,72 +70,303 @@ long long currentTimeMillis() {
     return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
 }
 
-void Search::checkTime() {
-    if (params.timeLimit != -1) {
-        if (currentTimeMillis() - params.startTime >= params.timeLimit) {
-            params.stopped = true;
+void Search::checkTime(SearchContext& ctx) {
+    if (ctx.timeLimit != -1) {
+        if (currentTimeMillis() - ctx.startTime >= ctx.timeLimit) {
+            ctx.stopped = true;
+        }
+    }
+}
+
+void Search::initReductions() {
+    for (int d = 0; d < Board::MAX_DEPTH; d++) {
+        for (int m = 0; m < LMR_MOVES; m++) {
+            if (d == 0 || m == 0) {
+                reductions[d][m] = 0;
+                continue;
+            }
+            double r = tune.lmrBase / 100.0 + std::log(d) * std::log(m) / (tune.lmrDivisor / 100.0);
+            reductions[d][m] = std::max(0, (int)r);
         }
     }
 }
 
-// MVV-LVA table [Victim][Attacker]
-static int MVV_LVA[14][14];
-static bool mvv_init = false;
+static bool hasNonPawnMaterial(const Board& board, int side) {
+    return (board.bitboards[Board::KNIGHT | side] | board.bitboards[Board::BISHOP | side]
+        | board.bitboards[Board::ROOK | side] | board.bitboards[Board::QUEEN | side]) != 0;
+}
 
-void init_mvv() {
-    if (mvv_init) return;
-    int values[] = { 0, 0, 100, 100, 200, 200, 300, 300, 400, 400, 500, 500, 600, 600 };
-    for (int v = 2; v < 14; v++) {
-        for (int a = 2; a < 14; a++) {
-            MVV_LVA[v][a] = values[v] + 10 - (values[a] / 100);
+int Search::reduction(bool pvNode, int depth, int moveNumber) {
+    int r = reductions[std::min(depth, Board::MAX_DEPTH - 1)][std::min(moveNumber, LMR_MOVES - 1)];
+    return pvNode ? r - 1 : r;
+}
+
+// Called on a cutoff by bestMove: it gets the bonus, the moves searched before
+// it get the malus. A quiet cutoff also updates the killers and counter move.
+void Search::updateHistories(SearchThread& t, PieceToHistory* const cont[2], int bestMove, int depth,
+                             const int* quiets, int quietCount, const int* captures, int captureCount) {
+    Board& board = t.board;
+    HistoryTables& h = t.history;
+    int bonus = HistoryTables::bonus(depth);
+
+    if (MovePicker::isQuiet(bestMove)) {
+        if (bestMove != t.stack[board.ply].killers[0]) {
+            t.stack[board.ply].killers[1] = t.stack[board.ply].killers[0];
+            t.stack[board.ply].killers[0] = bestMove;
+        }
+        if (board.ply > 0 && t.stack[board.ply - 1].piece != Board::EMPTY) {
+            SearchStack& prev = t.stack[board.ply - 1];
+            h.counterMoves[prev.piece][prev.to] = bestMove;
         }
+
+        for (int i = 0; i <= quietCount; i++) {
+            int move = i < quietCount ? quiets[i] : bestMove;
+            int b = i < quietCount ? -bonus : bonus;
+            int piece = HistoryTables::piece(board, move);
+            int to = HistoryTables::to(board, move);
+            HistoryTables::update(h.quiet[piece][to], b);
+            for (int c = 0; c < 2; c++) {
+                if (cont[c] != &h.continuation[0][0])
+                    HistoryTables::update((*cont[c])[piece][to], b);
+            }
+        }
+    }
+    else {
+        int piece = board.board[Move::from(bestMove)];
+        HistoryTables::update(h.capture[piece][Move::to(bestMove)][HistoryTables::victim(board, bestMove)], bonus);
+    }
+
+    for (int i = 0; i < captureCount; i++) {
+        int move = captures[i];
+        int piece = board.board[Move::from(move)];
+        HistoryTables::update(h.capture[piece][Move::to(move)][HistoryTables::victim(board, move)], -bonus);
     }
-    mvv_init = true;
 }
 
-int Search::iterativeDeepening(Board& board, int maxDepth, long long moveTime, bool verbose) {
-    init_mvv();
-    params.nodes = 0;
-    params.stopped = false;
-    params.bestMove = Move::NO_MOVE;
-    params.startTime = currentTimeMillis();
-    params.timeLimit = moveTime;
-    params.depthLimit = maxDepth;
+// Runs the search on numThreads threads. Thread 0 is the main thread: it owns
+// the time check and the info output, and stops the helpers when it is done.
+void Search::startThreads(SearchContext& ctx, Board& board, int maxDepth, long long moveTime, bool verbose, int numThreads) {
+    MovePicker::init();
+    std::call_once(reductionsInit, initReductions);
+    ctx.startTime = currentTimeMillis();
+    ctx.timeLimit = moveTime;
+    ctx.depthLimit = maxDepth;
+    board.hashTable->newSearch();
+    int savedThreads = ctx.numThreads;
+    ctx.numThreads = numThreads;
+    int pvCount = std::max(1, std::min(ctx.multiPV, countLegalMoves(board)));
+
+    SearchThread* threads = new SearchThread[numThreads];
+    ctx.threads = threads;
+    for (int i = 0; i < numThreads; i++) {
+        threads[i].id = i;
+        threads[i].ctx = &ctx;
+        threads[i].board = board;
+        threads[i].board.ttStats = &threads[i].ttStats;
+        threads[i].history.clear();
+        threads[i].pvCount = pvCount;
+    }
 
-    int alpha = -INFINITE;
-    int beta = INFINITE;
+    std::vector<std::thread> helpers;
+    for (int i = 1; i < numThreads; i++)
+        helpers.push_back(std::thread(searchWorker, &threads[i], false));
+
+    searchWorker(&threads[0], verbose);
+
+    ctx.stopped = true;
+    for (auto& h : helpers)
+        h.join();
+
+    // The vote picks a move, it cannot pick a set of lines
+    SearchThread* best = numThreads > 1 && pvCount == 1 ? voteBestThread(ctx) : &threads[0];
+    ctx.bestMove = best->bestMove;
+    ctx.bestScore = best->bestScore;
+    ctx.completedDepth = best->completedDepth;
+    ctx.pvLength = best->bestPvLength;
+    std::copy(best->bestPv, best->bestPv + best->bestPvLength, ctx.pv);
+
+    std::lock_guard<std::mutex> lock(board.hashTable->statsLock);
+    TTStats& stats = board.hashTable->stats;
+    for (int i = 0; i < numThreads; i++)
+        stats.add(threads[i].ttStats);
+    stats.searches++;
+    stats.nodes += ctx.totalNodes();
+
+    delete[] threads;
+    ctx.threads = nullptr;
+    ctx.numThreads = savedThreads;
+}
 
-    for (int d = 1; d <= params.depthLimit; d++) {
-        board.ply = 0;
-        int score = alphaBeta(board, alpha, beta, d, true);
+void Search::searchWorker(SearchThread* t, bool verbose) {
+    SearchContext& ctx = *t->ctx;
+    Board& board = t->board;
 
-        // If search was stopped during this depth, don't use the results
-        if (params.stopped) break;
+    // Helpers start at staggered depths so the threads spread over different iterations
+    int startDepth = 1 + (t->id & 1);
 
-        int pvCount = HashTable::getPVLine(d, board);
+    for (int d = startDepth; d <= ctx.depthLimit; d++) {
+        t->rootDepth = d;
 
-        if (verbose) {
-            std::cout << "info depth " << d << " score cp " << score << " nodes " << params.nodes
-                << " time " << (currentTimeMillis() - params.startTime) << " pv ";
+        // Each MultiPV line is searched in turn, without the moves of the lines before it
+        for (t->pvIdx = 0; t->pvIdx < t->pvCount; t->pvIdx++) {
+            RootLine& line = t->lines[t->pvIdx];
+            int alpha = -INFINITE;
+            int beta = INFINITE;
+            int delta = ASPIRATION_WINDOW;
+            int score;
 
-            for (int i = 0; i < pvCount; i++) {
-                std::cout << Move::toLongNotation(board.pvArray[i]) << " ";
+            // Aspiration window around the line's last score, widened on every fail
+            if (d >= ASPIRATION_DEPTH && abs(line.score) < ISMATE) {
+                alpha = std::max(-INFINITE, line.score - delta);
+                beta = std::min(INFINITE, line.score + delta);
             }
-            std::cout << std::endl;
+
+            while (true) {
+                board.ply = 0;
+                t->rootBestMove = Move::NO_MOVE;
+                score = alphaBeta(*t, alpha, beta, d, true);
+
+                if (ctx.stopped) break;
+
+                if (score <= alpha) {
+                    if (verbose) printInfo(t, d, t->pvIdx, score, HFALPHA);
+                    beta = (alpha + beta) / 2;
+                    alpha = std::max(-INFINITE, score - delta);
+                }
+                else if (score >= beta) {
+                    if (verbose) printInfo(t, d, t->pvIdx, score, HFBETA);
+                    beta = std::min(INFINITE, score + delta);
+                }
+                else {
+                    break;
+                }
+                delta += delta / 2;
+            }
+
+            if (ctx.stopped) break;
+
+            line.move = t->rootBestMove;
+            line.score = score;
+            line.pvLength = t->pvLength[0];
+            std::copy(t->pv[0], t->pv[0] + t->pvLength[0], line.pv);
+        }
+
+        // If search was stopped during this depth, don't use the results
+        if (ctx.stopped) break;
+
+        // A later line can score above an earlier one after a fail low of the
+        // earlier one, keep them in order
+        std::stable_sort(t->lines, t->lines + t->pvCount,
+                         [](const RootLine& a, const RootLine& b) { return a.score > b.score; });
+
+        RootLine& best = t->lines[0];
+        t->bestScore = best.score;
+        t->bestMove = best.move;
+        t->completedDepth = d;
+        t->bestPvLength = best.pvLength;
+        std::copy(best.pv, best.pv + best.pvLength, t->bestPv);
+
+        if (t->id == 0 && verbose) {
+            for (int i = 0; i < t->pvCount; i++)
+                printInfo(t, d, i, t->lines[i].score, HFEXACT);
+        }
+
+        // Analysis with several lines goes on, the other lines can still change
+        if (t->pvCount == 1 && (best.score > MATE || best.score < -MATE)) break;
+    }
+}
+
+// Info line of the main thread. Bounds come from aspiration fails and carry no pv.
+void Search::printInfo(SearchThread* t, int depth, int line, int score, int bound) {
+    if (t->id != 0) return;
+    SearchContext& ctx = *t->ctx;
+    long long elapsed = currentTimeMillis() - ctx.startTime;
+    long long nodes = ctx.totalNodes();
+
+    std::cout << "info depth " << depth;
+    if (t->pvCount > 1)
+        std::cout << " multipv " << (line + 1);
+    std::cout << " score cp " << score;
+    if (bound == HFBETA)
+        std::cout << " lowerbound";
+    else if (bound == HFALPHA)
+        std::cout << " upperbound";
+    std::cout << " nodes " << nodes
+        << " nps " << (nodes * 1000 / (elapsed + 1))
+        << " hashfull " << t->board.hashTable->hashfull()
+        << " time " << elapsed;
+
+    if (bound == HFEXACT) {
+        const RootLine& l = t->lines[line];
+        std::cout << " pv ";
+        for (int i = 0; i < l.pvLength; i++) {
+            std::cout << Move::toLongNotation(l.pv[i]) << " ";
+        }
+    }
+    std::cout << std::endl;
+}
+
+int Search::countLegalMoves(Board& board) {
+    MoveList moves;
+    MoveGen::pseudoLegalMoves(&board, board.state.currentPlayer, moves, false);
+    int count = 0;
+    for (int i = 0; i < moves.size(); i++) {
+        BoardState undo = board.makeMove(moves.get(i));
+        if (undo.valid) {
+            count++;
+            board.undoMove(moves.get(i), undo);
         }
-        params.bestMove = board.pvArray[0];
-        if (score > MATE || score < -MATE) break;
     }
+    return count;
+}
+
+// Root moves that already have a line in this iteration
+bool Search::isSearchedRootMove(const SearchThread& t, int move) {
+    for (int i = 0; i < t.pvIdx; i++) {
+        if (t.lines[i].move == move)
+            return true;
+    }
+    return false;
+}
+
+// Each thread votes for its best move, weighted by score and completed depth.
+// Returns a thread with the winning move, its score and PV go with it.
+SearchThread* Search::voteBestThread(SearchContext& ctx) {
+    SearchThread* threads = ctx.threads;
+    std::map<int, long long> votes;
+    int minScore = INFINITE;
+    for (int i = 0; i < ctx.numThreads; i++) {
+        if (threads[i].completedDepth > 0)
+            minScore = std::min(minScore, threads[i].bestScore);
+    }
+
+    SearchThread* best = &threads[0];
+    for (int i = 0; i < ctx.numThreads; i++) {
+        SearchThread& t = threads[i];
+        if (t.completedDepth == 0 || t.bestMove == Move::NO_MOVE) continue;
+        votes[t.bestMove] += (long long)(t.bestScore - minScore + 14) * t.completedDepth;
+    }
+    for (int i = 0; i < ctx.numThreads; i++) {
+        SearchThread& t = threads[i];
+        if (t.completedDepth == 0 || t.bestMove == Move::NO_MOVE) continue;
+        if (best->bestMove == Move::NO_MOVE || votes[t.bestMove] > votes[best->bestMove])
+            best = &t;
+    }
+    return best;
+}
+
+int Search::iterativeDeepening(SearchContext& ctx, Board& board, int maxDepth, long long moveTime, bool verbose) {
+    startThreads(ctx, board, maxDepth, moveTime, verbose, std::max(1, ctx.numThreads));
 
     // Final output: ensure we output a bestmove even if search was stopped
-    if (params.bestMove == Move::NO_MOVE) {
+    if (ctx.bestMove == Move::NO_MOVE) {
         // Fallback: just get any legal move if something went wrong
         MoveList moves;
         MoveGen::pseudoLegalMoves(&board, board.state.currentPlayer, moves, false);
         for (int i = 0; i < moves.size(); i++) {
             BoardState undo = board.makeMove(moves.get(i));
             if (undo.valid) {
-                params.bestMove = moves.get(i);
+                ctx.bestMove = moves.get(i);
                 board.undoMove(moves.get(i), undo);
                 break;
             }
@@ -91,39 +374,30 @@ int Search::iterativeDeepening(Board& board, int maxDepth, long long moveTime, b
     }
 
     if (verbose)
-        std::cout << "bestmove " << Move::toLongNotation(params.bestMove) << std::endl;
-    return params.bestMove;
-}
-
-int Search::iterativeDeepeningScore(Board& board, int maxDepth, long long moveTime, bool verbose) {
-    init_mvv();
-    params.nodes = 0;
-    params.stopped = false;
-    params.bestMove = Move::NO_MOVE;
-    params.startTime = currentTimeMillis();
-    params.timeLimit = moveTime;
-    params.depthLimit = maxDepth;
-
-    int alpha = -INFINITE;
-    int beta = INFINITE;
-    int finalScore = INVALID_SCORE;
+        std::cout << "bestmove " << Move::toLongNotation(ctx.bestMove) << std::endl;
 
-    for (int d = 1; d <= params.depthLimit; d++) {
-        board.ply = 0;
-        int score = alphaBeta(board, alpha, beta, d, true);
+    return ctx.bestMove;
+}
 
-        if (params.stopped) break;
-        finalScore = score;
+int Search::iterativeDeepeningScore(SearchContext& ctx, Board& board, int maxDepth, long long moveTime, bool verbose) {
+    // Labelling runs are parallel over positions, so a single thread per search
+    startThreads(ctx, board, maxDepth, moveTime, verbose, 1);
 
-        if (score > MATE || score < -MATE) break;
-    }
-    return finalScore;
+    return ctx.completedDepth > 0 ? ctx.bestScore : INVALID_SCORE;
 }
 
-int Search::alphaBeta(Board& board, int alpha, int beta, int depth, bool doNull) {
+// Principal variation search. Nodes searched with an open window are PV nodes,
+// every other node is searched with a null window and can only fail high or low.
+int Search::alphaBeta(SearchThread& t, int alpha, int beta, int depth, bool doNull) {
+    NO_ALLOC_SCOPE();
+    SearchContext& ctx = *t.ctx;
+    Board& board = t.board;
+    bool pvNode = beta - alpha > 1;
+    t.pvLength[board.ply] = board.ply;
+
     // Check time every 2048 nodes to avoid overhead of system clock calls
-    if ((params.nodes & 2047) == 0) checkTime();
-    if (params.stopped) return 0;
+    if (t.id == 0 && (t.nodes & 2047) == 0) checkTime(ctx);
+    if (ctx.stopped) return 0;
 
     if ((board.state.halfMoves >= 100 || board.isRepetition()) && board.ply > 0){
         return 0;
@@ -134,119 +408,279 @@ int Search::alphaBeta(Board& board, int alpha, int beta, int depth, bool doNull)
         return Evaluation::evaluate(board);
     }
 
-    params.nodes++;
-    if (depth <= 0) return quiescence(board, alpha, beta);
+    t.nodes.fetch_add(1, std::memory_order_relaxed);
+    if (depth <= 0) return quiescence(t, alpha, beta);
 
+    int excludedMove = t.stack[board.ply].excludedMove;
     int pvMove = Move::NO_MOVE;
     int hashScore = 0;
-    if (HashTable::probeHashEntry(board, &pvMove, &hashScore, alpha, beta, depth)) {
+    int hashDepth = -1;
+    int hashFlags = HFNONE;
+    int hashEval = HashEntry::NO_EVAL;
+    // No cutoffs at the root: every thread must produce its own root best move.
+    // None either while excluding a move, the entry is for the full move list.
+    if (board.ply == 0) {
+        // Later MultiPV lines start from the move of the same line last iteration
+        pvMove = t.pvIdx > 0 ? t.lines[t.pvIdx].move : HashTable::probePvMove(board);
+    }
+    else if (excludedMove == Move::NO_MOVE
+        && HashTable::probeHashEntry(board, &pvMove, &hashScore, alpha, beta, depth, &hashDepth, &hashFlags, &hashEval)
+        && !pvNode) {
+        // PV nodes search on so that the PV they report is complete
         return hashScore;
     }
 
     int side = board.state.currentPlayer;
     bool inCheck = MoveGen::isSquareAttacked(&board, board.kingSQ[side], side ^ 1);
 
-    if (doNull && !inCheck && depth >= 3 && board.material[side] > 500) {
-        BoardState undo = board.makeNullMove();
-        int score = -alphaBeta(board, -beta, -beta + 1, depth - 3, false);
+    // Static eval once per node, from the hash entry when it has one, kept on
+    // the stack for the plies below
+    int staticEval = inCheck ? -INFINITE : (hashEval != HashEntry::NO_EVAL ? hashEval : Evaluation::evaluate(board));
+    int storeEval = inCheck ? HashEntry::NO_EVAL : staticEval;
+    t.stack[board.ply].staticEval = staticEval;
+    bool improving = !inCheck && board.ply >= 2 && staticEval > t.stack[board.ply - 2].staticEval;
+
+    if (!pvNode && !inCheck && excludedMove == Move::NO_MOVE) {
+        // Reverse futility: far enough above beta that a quiet move will not fall below it
+        if (depth <= RFP_DEPTH && abs(beta) < ISMATE
+            && staticEval - tune.rfpMargin * (depth - improving) >= beta)
+            return beta;
+
+        // Razoring: far below alpha, only captures can save the node
+        if (depth <= RAZOR_DEPTH && staticEval + tune.razorMargin * depth < alpha) {
+            int score = quiescence(t, alpha, beta);
+            if (ctx.stopped) return 0;
+            if (score <= alpha) return alpha;
+        }
+    }
+
+    // Futility: quiet moves that do not give check cannot lift the eval to alpha
+    bool futile = !pvNode && !inCheck && depth <= FUTILITY_DEPTH && abs(alpha) < ISMATE
+        && staticEval + tune.futilityMargin * depth <= alpha;
+
+    // Null move: if passing still fails high, a real move will too. The search
+    // after the pass is shallower the deeper the node and the further the eval
+    // is above beta. Only with pieces on the board, zugzwang is common with
+    // pawns alone, and deep cutoffs are verified by a reduced normal search.
+    if (!pvNode && doNull && !inCheck && excludedMove == Move::NO_MOVE && depth >= NULL_MOVE_DEPTH
+        && staticEval >= beta && abs(beta) < ISMATE && hasNonPawnMaterial(board, side)) {
+        int r = NULL_MOVE_R + depth / 4 + std::min((staticEval - beta) / tune.nullMoveDivisor, 3);
+        int nullDepth = std::max(0, depth - r);
+
+        t.stack[board.ply].move = Move::NO_MOVE;
+        t.stack[board.ply].piece = Board::EMPTY;
+        t.stack[board.ply].to = 0;
+        BoardState undo = board.makeNullMove(true);
+        int score = -alphaBeta(t, -beta, -beta + 1, nullDepth, false);
         board.undoNullMove(undo);
-        if (params.stopped) return 0;
-        if (score >= beta) return beta;
+        if (ctx.stopped) return 0;
+
+        // A mate found after passing proves nothing about this node, only beta is returned
+        if (score >= beta) {
+            if (depth < NULL_VERIFY_DEPTH)
+                return beta;
+            score = alphaBeta(t, beta - 1, beta, nullDepth, false);
+            if (ctx.stopped) return 0;
+            if (score >= beta) return beta;
+        }
     }
 
-    MoveList moves;
-    MoveGen::pseudoLegalMoves(&board, side, moves, inCheck);
-    sortMoves(moves, board, pvMove, board.ply);
+    // ProbCut: a capture that beats beta by a margin in a much shallower search
+    // would almost surely beat beta at full depth. Only captures that win enough
+    // material by SEE to reach that margin from the static eval are tried, each
+    // confirmed by quiescence before the reduced search. Not when the hash entry
+    // is deep enough and already below the raised beta.
+    int probBeta = beta + tune.probCutMargin;
+    if (!pvNode && !inCheck && excludedMove == Move::NO_MOVE && depth >= PROBCUT_DEPTH && abs(beta) < ISMATE
+        && !(hashDepth >= depth - PROBCUT_REDUCTION + 1 && hashFlags != HFNONE && hashScore < probBeta)) {
+        MovePicker capturePicker(board, t.history, t.stack[board.ply].killers, pvMove, false);
+        int move;
+        while ((move = capturePicker.next()) != Move::NO_MOVE) {
+            int from = Move::from(move);
+            if (see(&board, Move::to(move), board.board[Move::to(move)], from, board.board[from]) < probBeta - staticEval)
+                continue;
+
+            t.stack[board.ply].move = move;
+            t.stack[board.ply].piece = HistoryTables::piece(board, move);
+            t.stack[board.ply].to = HistoryTables::to(board, move);
+            BoardState undo = board.makeMove(move, true);
+            if (!undo.valid) continue;
+
+            int score = -quiescence(t, -probBeta, -probBeta + 1);
+            if (score >= probBeta)
+                score = -alphaBeta(t, -probBeta, -probBeta + 1, depth - PROBCUT_REDUCTION, true);
+            board.undoMove(move, undo);
+            if (ctx.stopped) return 0;
+
+            if (score >= probBeta) {
+                HashTable::storeHashEntry(board, move, probBeta, HFBETA, depth - PROBCUT_REDUCTION + 1, storeEval);
+                return beta;
+            }
+        }
+    }
+
+    // Internal iteration: with no hash move the node would be ordered by history
+    // alone. Applies to PV nodes and to the nodes expected to fail high.
+    if (board.ply > 0 && pvMove == Move::NO_MOVE && excludedMove == Move::NO_MOVE && depth >= IID_DEPTH
+        && (pvNode || staticEval >= beta)) {
+        if (tune.iidMode == IID_REDUCE) {
+            depth--;
+        }
+        else if (tune.iidMode == IID_SEARCH) {
+            alphaBeta(t, alpha, beta, pvNode ? depth - 2 : depth / 2, doNull);
+            if (ctx.stopped) return 0;
+            pvMove = HashTable::probePvMove(board);
+            t.pvLength[board.ply] = board.ply;
+        }
+    }
 
+    // Singular extension: when a search without the hash move, at half depth,
+    // fails low against a margin below the hash score, the hash move is the
+    // only good one and gets searched one ply deeper
+    bool singular = false;
+    if (board.ply > 0 && depth >= SINGULAR_DEPTH && excludedMove == Move::NO_MOVE && pvMove != Move::NO_MOVE
+        && hashDepth >= depth - 3 && (hashFlags == HFBETA || hashFlags == HFEXACT) && abs(hashScore) < ISMATE) {
+        int singularBeta = hashScore - SINGULAR_MARGIN * depth;
+        t.stack[board.ply].excludedMove = pvMove;
+        int score = alphaBeta(t, singularBeta - 1, singularBeta, (depth - 1) / 2, false);
+        t.stack[board.ply].excludedMove = Move::NO_MOVE;
+        if (ctx.stopped) return 0;
+        singular = score < singularBeta;
+    }
+
+    // Continuation history of the moves one and two plies up, the [0][0] row
+    // stands in when there is no such move
+    HistoryTables& h = t.history;
+    PieceToHistory* cont[2];
+    for (int i = 0; i < 2; i++) {
+        SearchStack* prev = board.ply > i ? &t.stack[board.ply - 1 - i] : nullptr;
+        cont[i] = prev != nullptr && prev->piece != Board::EMPTY ? &h.continuation[prev->piece][prev->to]
+                                                                 : &h.continuation[0][0];
+    }
+    int counterMove = Move::NO_MOVE;
+    if (board.ply > 0 && t.stack[board.ply - 1].piece != Board::EMPTY)
+        counterMove = h.counterMoves[t.stack[board.ply - 1].piece][t.stack[board.ply - 1].to];
+
+    MovePicker picker(board, h, cont, t.stack[board.ply].killers, counterMove, pvMove, inCheck);
+    // A root searched for a later MultiPV line lacks the better moves, its
+    // result is not the position's
+    bool partialRoot = board.ply == 0 && t.pvIdx > 0;
     int legalMovesCount = 0;
     int oldAlpha = alpha;
     int bestMove = Move::NO_MOVE;
-
-    for (int i = 0; i < moves.size(); i++) {
-        int move = moves.get(i);
-        BoardState undo = board.makeMove(move);
+    int move;
+    // Moves searched without a cutoff, they get the malus when a later move cuts
+    int quiets[64], captures[32];
+    int quietCount = 0, captureCount = 0;
+
+    while ((move = picker.next()) != Move::NO_MOVE) {
+        if (move == excludedMove) continue;
+        if (board.ply == 0 && isSearchedRootMove(t, move)) continue;
+
+        bool quiet = MovePicker::isQuiet(move);
+        bool killer = move == t.stack[board.ply].killers[0] || move == t.stack[board.ply].killers[1];
+        int piece = HistoryTables::piece(board, move);
+        int to = HistoryTables::to(board, move);
+        int history = quiet ? h.quiet[piece][to] + (*cont[0])[piece][to] + (*cont[1])[piece][to] : 0;
+
+        t.stack[board.ply].move = move;
+        t.stack[board.ply].piece = piece;
+        t.stack[board.ply].to = to;
+        BoardState undo = board.makeMove(move, true);
         if (!undo.valid) continue;
 
         legalMovesCount++;
-        int score = -alphaBeta(board, -beta, -alpha, depth - 1, true);
+        bool givesCheck = MoveGen::isSquareAttacked(&board, board.kingSQ[side ^ 1], side);
+        if (futile && quiet && legalMovesCount > 1 && !killer && !givesCheck) {
+            board.undoMove(move, undo);
+            continue;
+        }
+
+        // Checks and a singular hash move are searched a ply deeper, within
+        // twice the iteration depth so that checking sequences stay bounded
+        int extension = 0;
+        if ((givesCheck || (singular && move == pvMove)) && board.ply <= 2 * t.rootDepth)
+            extension = 1;
+        int newDepth = depth - 1 + extension;
+
+        int score;
+        // The first move gets the full window, the rest only have to prove they
+        // are worse and are searched again if one turns out better
+        if (legalMovesCount == 1) {
+            score = -alphaBeta(t, -beta, -alpha, newDepth, true);
+        }
+        else {
+            // Late quiet moves are searched shallower first
+            int r = 0;
+            if (depth >= LMR_DEPTH && quiet && !inCheck) {
+                r = reduction(pvNode, depth, legalMovesCount);
+                if (killer) r--;
+                r -= history / LMR_HISTORY;
+                if (givesCheck) r--;
+                r = std::max(0, std::min(r, newDepth - 1));
+            }
+
+            score = -alphaBeta(t, -alpha - 1, -alpha, newDepth - r, true);
+            if (r > 0 && score > alpha)
+                score = -alphaBeta(t, -alpha - 1, -alpha, newDepth, true);
+            if (pvNode && score > alpha && score < beta)
+                score = -alphaBeta(t, -beta, -alpha, newDepth, true);
+        }
         board.undoMove(move, undo);
 
-        if (params.stopped) return 0;
+        if (ctx.stopped) return 0;
 
-        if (score >= beta) {
-            if (Move::captured(move) == Board::EMPTY) {
-                board.searchKillers[1][board.ply] = board.searchKillers[0][board.ply];
-                board.searchKillers[0][board.ply] = move;
+        // The PV from here is this move followed by the child's PV
+        if (pvNode && score > alpha) {
+            int ply = board.ply;
+            t.pv[ply][ply] = move;
+            for (int i = ply + 1; i < t.pvLength[ply + 1]; i++)
+                t.pv[ply][i] = t.pv[ply + 1][i];
+            t.pvLength[ply] = std::max(ply + 1, t.pvLength[ply + 1]);
+        }
 
-                 // History heuristic
-                int piece = board.board[Move::from(move)];
-                board.searchHistory[piece][Move::to(move)] += depth * depth;
-            }
-            HashTable::storeHashEntry(board, move, beta, HFBETA, depth);
+        if (score >= beta) {
+            updateHistories(t, cont, move, depth, quiets, quietCount, captures, captureCount);
+            if (board.ply == 0) t.rootBestMove = move;
+            if (excludedMove == Move::NO_MOVE && !partialRoot)
+                HashTable::storeHashEntry(board, move, beta, HFBETA, depth, storeEval);
             return beta;
         }
         if (score > alpha) {
             alpha = score;
             bestMove = move;
+            if (board.ply == 0) t.rootBestMove = move;
         }
+        if (quiet && quietCount < 64) quiets[quietCount++] = move;
+        else if (!quiet && captureCount < 32) captures[captureCount++] = move;
     }
 
     if (legalMovesCount == 0) {
+        // The excluded move was the only one, nothing to compare it with
+        if (excludedMove != Move::NO_MOVE) return alpha;
         return inCheck ? (-MATE + board.ply) : 0;
     }
 
+    if (excludedMove != Move::NO_MOVE || partialRoot) return alpha;
+
     int flag = (alpha > oldAlpha) ? HFEXACT : HFALPHA;
-    HashTable::storeHashEntry(board, bestMove, alpha, flag, depth);
+    HashTable::storeHashEntry(board, bestMove, alpha, flag, depth, storeEval);
     return alpha;
 }
 
-int Search::scoreMove(const Board& board, int move, int pvMove) {
-    if (move == pvMove) return 2000000;
-
-    int captured = Move::captured(move);
-    if (captured != Board::EMPTY) {
-        int attacker = board.board[Move::from(move)];
-        return 1000000 + MVV_LVA[captured][attacker];
-    }
-
-    // Killer moves
-    if (board.searchKillers[0][board.ply] == move) return 900000;
-    if (board.searchKillers[1][board.ply] == move) return 800000;
-
-    // History heuristic
-    return board.searchHistory[board.board[Move::from(move)]][Move::to(move)];
-}
-
-void Search::sortMoves(MoveList& moves, const Board& board, int pvMove, int ply) {
-    struct MoveScore {
-        int move;
-        int score;
-    };
-
-    std::vector<MoveScore> scoredMoves;
-    for (int i = 0; i < moves.size(); i++) {
-        scoredMoves.push_back({ moves.get(i), scoreMove(board, moves.get(i), pvMove) });
-    }
-
-    // Simple selection sort for the MoveList
-    for (int i = 0; i < moves.size(); i++) {
-        for (int j = i + 1; j < moves.size(); j++) {
-            if (scoredMoves[j].score > scoredMoves[i].score) {
-                std::swap(scoredMoves[i], scoredMoves[j]);
-            }
-        }
-        moves.set(i, scoredMoves[i].move);
-    }
-}
-
-int Search::quiescence(Board& board, int alpha, int beta) {
+int Search::quiescence(SearchThread& t, int alpha, int beta) {
+    NO_ALLOC_SCOPE();
     assert(alpha < beta);
+    SearchContext& ctx = *t.ctx;
+    Board& board = t.board;
 
     // 1. Periodic Resource Check
-    if ((params.nodes & 2047) == 0) checkTime();
-    if (params.stopped) return 0;
+    if (t.id == 0 && (t.nodes & 2047) == 0) checkTime(ctx);
+    if (ctx.stopped) return 0;
 
-    params.nodes++;
+    t.nodes.fetch_add(1, std::memory_order_relaxed);
+    t.ttStats.qnodes++;
+    t.pvLength[board.ply] = board.ply;
 
     // 2. Check for Repetition / 50-move rule
     // Essential now that we allow non-capture evasions (perpetual check detection)
@@ -259,17 +693,33 @@ int Search::quiescence(Board& board, int alpha, int beta) {
         return Evaluation::evaluate(board);
     }
 
-    // 3. Check State Analysis
+    // 3. Hash Table: any entry is deep enough to cut, and gives a capture to
+    // try first and the static eval
+    int hashMove = Move::NO_MOVE;
+    int hashScore = 0;
+    int hashDepth = -1;
+    int hashEval = HashEntry::NO_EVAL;
+    if (HashTable::probeHashEntry(board, &hashMove, &hashScore, alpha, beta, 0, &hashDepth, nullptr, &hashEval)) {
+        return hashScore;
+    }
+
+    // 4. Check State Analysis
     int side = board.state.currentPlayer;
     bool inCheck = MoveGen::isSquareAttacked(&board, board.kingSQ[side], side ^ 1);
 
-    // 4. Stand-Pat (Only if NOT in check)
+    // 5. Stand-Pat (Only if NOT in check)
     int standPat = -Search::INFINITE;
+    int storeEval = HashEntry::NO_EVAL;
+    int oldAlpha = alpha;
 
     if (!inCheck) {
-        standPat = Evaluation::evaluate(board);
+        standPat = hashEval != HashEntry::NO_EVAL ? hashEval : Evaluation::evaluate(board);
+        storeEval = standPat;
 
         if (standPat >= beta) {
+            // Keep the eval of new positions, a lower bound never replaces an entry we have
+            if (hashDepth < 0)
+                HashTable::storeHashEntry(board, Move::NO_MOVE, beta, HFBETA, 0, storeEval);
             return beta;
         }
 
@@ -278,59 +728,38 @@ int Search::quiescence(Board& board, int alpha, int beta) {
         }
     }
 
-    // 5. Move Generation
-    MoveList moves;
-    
-    if (inCheck) {
-        U64 occup = board.bitboards[Board::WHITE] | board.bitboards[Board::BLACK];
-        MoveGen::getEvasions(&board, side, moves, occup);
-    }
-    else {
-        MoveGen::pseudoLegalCaptureMoves(&board, side, moves);
-        MoveGen::pawnPromotions(&board, side, moves, true);
-    }
-
-    // 6. Score and Sort Moves
-    sortMoves(moves, board, Move::NO_MOVE, board.ply);
-
+    // 6. Captures best first, losing ones are never searched
+    MovePicker picker(board, t.history, t.stack[board.ply].killers, hashMove, inCheck);
     int legalMoves = 0;
+    int bestMove = Move::NO_MOVE;
+    int move;
 
-    for (int i = 0; i < moves.size(); i++) {
-        int move = moves.get(i);
-
-        // --- PRUNING (Only when NOT in Check) ---
-        if (!inCheck) {
-            int promote = Move::promoteTo(move);
-            int captured = Move::captured(move);
-
-            // Delta Pruning
-            if (promote == Board::EMPTY) {
-                int delta = abs(Evaluation::PIECE_VALUES[captured]) + 200;
-                if (standPat + delta < alpha) continue;
-            }
+    while ((move = picker.next()) != Move::NO_MOVE) {
 
-            // SEE Pruning
-            if (promote == Board::EMPTY) {
-                int from = Move::from(move);
-                int to = Move::to(move);
-                int piece = board.board[from];
-                // Check if capture loses material
-                if (see(&board, to, captured, from, piece) < 0) continue;
-            }
+        // Delta Pruning (Only when NOT in Check)
+        if (!inCheck && Move::promoteTo(move) == Board::EMPTY) {
+            int delta = abs(Evaluation::PIECE_VALUES[Move::captured(move)]) + 200;
+            if (standPat + delta < alpha) continue;
         }
 
-        BoardState undo = board.makeMove(move);
+        BoardState undo = board.makeMove(move, true);
         if (!undo.valid) continue;
 
         legalMoves++;
 
-        int score = -quiescence(board, -beta, -alpha);
+        int score = -quiescence(t, -beta, -alpha);
         board.undoMove(move, undo);
 
-        if (params.stopped) return 0;
+        if (ctx.stopped) return 0;
 
-        if (score >= beta) return beta;
-        if (score > alpha) alpha = score;
+        if (score >= beta) {
+            HashTable::storeHashEntry(board, move, beta, HFBETA, 0, storeEval);
+            return beta;
+        }
+        if (score > alpha) {
+            alpha = score;
+            bestMove = move;
+        }
     }
 
     // 7. Checkmate Detection
@@ -338,6 +767,7 @@ int Search::quiescence(Board& board, int alpha, int beta) {
         return -Search::MATE + board.ply;
     }
 
+    HashTable::storeHashEntry(board, bestMove, alpha, alpha > oldAlpha ? HFEXACT : HFALPHA, 0, storeEval);
     return alpha;
 }
 
@@ -428,7 +858,7 @@ int Search::see(const Board* board, int toSq, int target, int fromSq, int aPiece
         fromSet = getLeastValuablePiece(board, attadef, side, aPiece);
 
         // 'fromSq' is only needed if you use LINES_BB optimization above
-        fromSq = numberOfTrailingZeros(fromSet); 
+        if (fromSet) fromSq = numberOfTrailingZeros(fromSet);
 
     } while (fromSet);
 
@@ -8,9 +8,10 @@
 #include <map>
 #include <iostream>
 #include <fstream>
+#include <chrono>
 
 
-void TestSuite::runFile(std::string fl, int movetime) {
+void TestSuite::runFile(SearchContext& ctx, std::string fl, int movetime) {
 
 	HashTable hashTable;
 	std::ifstream file(fl);
@@ -52,8 +53,9 @@ void TestSuite::runFile(std::string fl, int movetime) {
 		Board board = FenParser::parseFEN(fen);
 		board.setHashTable(&hashTable);
 		hashTable.reset();
+		ctx.clearStop();
 
-		int mv = Search::iterativeDeepening(board, Board::MAX_DEPTH, movetime, false);
+		int mv = Search::iterativeDeepening(ctx, board, Board::MAX_DEPTH, movetime, false);
 		std::string moveFound = Move::toLongNotation(mv);
 		
 		if (moveFound == move) {
@@ -82,3 +84,35 @@ void TestSuite::runFile(std::string fl, int movetime) {
 	}
 	printf("Found %d of %d (%.1f%%)\n", corr, tot, 100.0 * corr / tot);	
 }
+
+
+void TestSuite::runNodes(SearchContext& ctx, std::string fl, int depth, int step) {
+
+	HashTable hashTable;
+	std::ifstream file(fl);
+	std::string line;
+
+	U64 nodes = 0, qnodes = 0;
+	int positions = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; std::getline(file, line); i++) {
+		if (i % step != 0)
+			continue;
+		std::string fen = trim(splitString(line, "bm")[0]);
+
+		Board board = FenParser::parseFEN(fen);
+		board.setHashTable(&hashTable);
+		hashTable.reset();
+		ctx.clearStop();
+
+		Search::iterativeDeepening(ctx, board, depth, -1, false);
+		nodes += hashTable.stats.nodes;
+		qnodes += hashTable.stats.qnodes;
+		positions++;
+	}
+
+	long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	printf("%d positions depth %d: %llu nodes (%llu quiescence) %lld ms %llu nps\n", positions, depth,
+		(unsigned long long)nodes, (unsigned long long)qnodes, ms, (unsigned long long)(nodes * 1000 / std::max(ms, 1LL)));
+}
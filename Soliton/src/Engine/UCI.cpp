@@ -4,22 +4,79 @@
 #include "Engine/TestSuite.h"
 #include "Engine/EvalFen.h"
 #include "Engine/Perft.h"
+#include "Engine/StringUtils.h"
 #include <iostream>
 #include <sstream>
+#include <algorithm>
 
 std::thread UCI::searchThread; 
+std::vector<UCIOption> UCI::options;
+SearchContext UCI::searchContext;
+
+void UCI::addOption(std::string name, std::string type, int defaultValue, int min, int max, std::function<void(int)> onChange) {
+    options.push_back({ name, type, defaultValue, min, max, defaultValue, onChange });
+}
+
+UCIOption* UCI::getOption(std::string name) {
+    for (auto& opt : options) {
+        if (toLower(opt.name) == toLower(name))
+            return &opt;
+    }
+    return nullptr;
+}
+
+void UCI::initOptions(HashTable* tt) {
+    options.clear();
+    // Hash in MB, up to 256 GB
+    addOption("Hash", "spin", tt->DEFAULT_SIZE, 1, 262144, [tt](int mb) { tt->initHash(mb); });
+    addOption("Threads", "spin", 1, 1, Search::MAX_THREADS, [](int n) { searchContext.setThreads(n); });
+    addOption("MultiPV", "spin", 1, 1, Search::MAX_MULTI_PV, [](int n) { searchContext.setMultiPV(n); });
+    // Read by parseGo, time reserved for GUI/network lag per move
+    addOption("Move Overhead", "spin", 10, 0, 5000, [](int) {});
+    // Search tuning, defaults come from Search::tune
+    addOption("LMR Base", "spin", Search::tune.lmrBase, 0, 300, [](int v) { Search::tune.lmrBase = v; Search::initReductions(); });
+    addOption("LMR Divisor", "spin", Search::tune.lmrDivisor, 100, 1000, [](int v) { Search::tune.lmrDivisor = v; Search::initReductions(); });
+    addOption("RFP Margin", "spin", Search::tune.rfpMargin, 0, 1000, [](int v) { Search::tune.rfpMargin = v; });
+    addOption("Futility Margin", "spin", Search::tune.futilityMargin, 0, 1000, [](int v) { Search::tune.futilityMargin = v; });
+    addOption("Razor Margin", "spin", Search::tune.razorMargin, 0, 2000, [](int v) { Search::tune.razorMargin = v; });
+    addOption("Null Move Divisor", "spin", Search::tune.nullMoveDivisor, 50, 1000, [](int v) { Search::tune.nullMoveDivisor = v; });
+    addOption("ProbCut Margin", "spin", Search::tune.probCutMargin, 0, 1000, [](int v) { Search::tune.probCutMargin = v; });
+    // 0 off, 1 internal iterative reduction, 2 internal iterative deepening
+    addOption("IID Mode", "spin", Search::tune.iidMode, Search::IID_OFF, Search::IID_SEARCH, [](int v) { Search::tune.iidMode = v; });
+}
+
+void UCI::printOptions() {
+    for (auto& opt : options) {
+        std::cout << "option name " << opt.name << " type " << opt.type;
+        if (opt.type == "check") {
+            std::cout << " default " << (opt.defaultValue ? "true" : "false") << std::endl;
+        }
+        else {
+            std::cout << " default " << opt.defaultValue << " min " << opt.min << " max " << opt.max << std::endl;
+        }
+    }
+}
+
+void UCI::stopSearch() {
+    if (searchThread.joinable()) {
+        searchContext.stop();
+        searchThread.join();
+    }
+}
 
 void UCI::loop() {
     Evaluation::initAll();
     Board board = Board::fromStartPosition();
-    HashTable* tt = new HashTable(256);
+    HashTable* tt = new HashTable();
     board.setHashTable(tt);
+    initOptions(tt);
 
     std::string line;
     while (std::getline(std::cin, line)) {
         if (line == "uci") {
             std::cout << "id name Soliton" << std::endl;
             std::cout << "id Fernando Mir" << std::endl;
+            printOptions();
             std::cout << "uciok" << std::endl;
         }
         else if (line == "isready") {
@@ -27,10 +84,7 @@ void UCI::loop() {
         }
         else if (line == "ucinewgame") {
             // Ensure search is stopped before resetting
-            if(searchThread.joinable()) {
-                Search::stop();
-                searchThread.join();
-            }
+            stopSearch();
             
             // 1. Clear the Transposition Table
             if (board.hashTable) {
@@ -42,6 +96,24 @@ void UCI::loop() {
             board = Board::fromStartPosition();
             board.setHashTable(tt);
         }
+        else if (line == "clear hash") {
+            stopSearch();
+            tt->clear();
+        }
+        else if (line.find("savehash ") == 0) {
+            stopSearch();
+            tt->save(trim(line.substr(9)));
+        }
+        else if (line.find("loadhash ") == 0) {
+            stopSearch();
+            tt->load(trim(line.substr(9)));
+        }
+        else if (line.find("setoption") == 0) {
+            // Options may reallocate shared state such as the hash table
+            stopSearch();
+            parseSetOption(line);
+            board.setHashTable(tt);
+        }
         else if (line.find("position") == 0) {
             parsePosition(line, board, tt);
         }
@@ -49,10 +121,7 @@ void UCI::loop() {
             parseGo(line, board);
         }
         else if (line == "stop") {
-            if (searchThread.joinable()) {
-                Search::stop();
-                searchThread.join();
-            }
+            stopSearch();
         }
         else if (line.find("evaltest") == 0) {
             Evaluation::testEval("positions.fen");
@@ -72,23 +141,69 @@ void UCI::loop() {
                 std::cout << "Error: Invalid format. Usage: eval <filename> <depth>" << std::endl;
             }
         }
+        else if (line == "stats") {
+            stopSearch();
+            tt->printStats();
+        }
+        else if (line.find("ttstress") == 0) {
+            std::stringstream ss(line);
+            std::string cmd;
+            int threads = 8, seconds = 5;
+            ss >> cmd >> threads >> seconds;
+            HashTable::stressTest(threads, seconds);
+        }
         else if (line.find("perft") == 0) {
             Perft::runAll("perft.txt");
         }
+        else if (line.find("benchnodes") == 0) {
+            // benchnodes [depth] [step]
+            std::stringstream ss(line);
+            std::string cmd;
+            int depth = 8, step = 15;
+            ss >> cmd >> depth >> step;
+            stopSearch();
+            TestSuite::runNodes(searchContext, "bench.epd", depth, std::max(1, step));
+        }
         else if (line.find("bench") == 0) {
-            TestSuite::runFile("bench.epd", 50);
+            stopSearch();
+            TestSuite::runFile(searchContext, "bench.epd", 50);
         }
         else if (line == "quit") {
             // Ensure search is stopped before quitting
-            if (searchThread.joinable()) {
-                Search::stop();
-                searchThread.join();
-            }
+            stopSearch();
             break;
         }
     }
 }
 
+void UCI::parseSetOption(std::string line) {
+    // setoption name <id> [value <x>]
+    size_t namePos = line.find("name ");
+    if (namePos == std::string::npos) return;
+
+    size_t valuePos = line.find(" value ");
+    std::string name = valuePos == std::string::npos ? line.substr(namePos + 5) : line.substr(namePos + 5, valuePos - namePos - 5);
+    std::string value = valuePos == std::string::npos ? "" : trim(line.substr(valuePos + 7));
+    name = trim(name);
+
+    UCIOption* opt = getOption(name);
+    if (!opt) {
+        std::cout << "info string unknown option " << name << std::endl;
+        return;
+    }
+
+    int v = opt->defaultValue;
+    if (opt->type == "check") {
+        v = toLower(value) == "true" ? 1 : 0;
+    }
+    else if (!(std::stringstream(value) >> v)) {
+        std::cout << "info string invalid value for " << opt->name << std::endl;
+        return;
+    }
+    opt->value = std::max(opt->min, std::min(v, opt->max));
+    opt->onChange(opt->value);
+}
+
 void UCI::parsePosition(std::string line, Board& board, HashTable* tt) {
     // Remove "position " from the beginning
     std::string input = line.substr(9);
@@ -161,14 +276,22 @@ void UCI::parseGo(std::string line, Board& board) {
         */
     }
 
+    if (movetime != -1) {
+        movetime = std::max(1LL, movetime - getOption("Move Overhead")->value);
+    }
+
     // Ensure any previous search is finished
     if (searchThread.joinable()) {
         searchThread.join();
     }
 
+    // Arm the stop flag here, not in the search thread, so that a stop sent
+    // right after go cannot be lost
+    searchContext.clearStop();
+
     // [board, depth, movetime] captures these variables by VALUE.
     // 'mutable' is required because iterativeDeepening modifies its local copy of the board.
     searchThread = std::thread([board, depth, movetime]() mutable {
-        Search::iterativeDeepening(board, depth, movetime, true);
+        Search::iterativeDeepening(searchContext, board, depth, movetime, true);
     });
 }
\ No newline at end of file
@@ -1,8 +1,6 @@
 #include "Engine/Zobrist.h"
 
-std::random_device Zobrist::rd;
 std::mt19937_64 Zobrist::gen;
-std::uniform_int_distribution<U64> Zobrist::dis;
 U64 Zobrist::pieceKeys[64][12];
 U64 Zobrist::castleKeys[16];
 U64 Zobrist::epKeys[8];
@@ -33,11 +31,15 @@ U64 Zobrist::getKey(const Board& board){
 	return key;
 }
 
+//raw engine output, the mt19937_64 sequence is fixed by the standard
+//(distributions are not)
 U64 Zobrist::random64(){
-	return dis(gen);
+	return gen();
 }
 
 void Zobrist::init_keys(){
+	gen.seed(SEED);
+
 	//piece keys
 	for (int sq = 0; sq < 64; sq++){
 		for (int p = 0; p < 12; p++){
@@ -57,6 +59,18 @@ void Zobrist::init_keys(){
 	sideBlackKey = random64();
 }
 
+U64 Zobrist::checksum(){
+	U64 sum = 0;
+	for (int sq = 0; sq < 64; sq++)
+		for (int p = 0; p < 12; p++)
+			sum = sum * 31 + pieceKeys[sq][p];
+	for (int i = 0; i < 16; i++)
+		sum = sum * 31 + castleKeys[i];
+	for (int i = 0; i < 8; i++)
+		sum = sum * 31 + epKeys[i];
+	return sum * 31 + sideBlackKey;
+}
+
 U64 Zobrist::xorFromTo(U64 key, int piece, int from, int to){
 	key ^= pieceKeys[from][piece - 2];
 	key ^= pieceKeys[to][piece - 2];